@@ -14,6 +14,42 @@
 #include <limits>
 #include <optional>
 #include <set>
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+#include <random>
+#include <cmath>
+#include <memory>
+
+#include "src/core/AppConfig.h"
+#include "src/core/CommandBundle.h"
+#include "src/core/DeletionQueue.h"
+#include "src/core/Defragmenter.h"
+#include "src/core/DescriptorLayoutCache.h"
+#include "src/core/DeviceAllocator.h"
+#include "src/core/FrameArena.h"
+#include "src/core/FramePacer.h"
+#include "src/core/FrameStats.h"
+#include "src/core/GeometryBuffer.h"
+#include "src/core/Hash.h"
+#include "src/core/HostAllocator.h"
+#include "src/core/JobSystem.h"
+#include "src/core/MeshData.h"
+#include "src/core/OffscreenTarget.h"
+#include "src/core/ParallelRecorder.h"
+#include "src/core/PipelineCache.h"
+#include "src/core/PipelineCompiler.h"
+#include "src/core/PipelineRegistry.h"
+#include "src/core/Profiler.h"
+#include "src/core/ShaderCompiler.h"
+#include "src/core/ShaderLibrary.h"
+#include "src/core/ShaderModuleCache.h"
+#include "src/core/ShaderVariants.h"
+#include "src/core/ShaderWatcher.h"
+#include "src/core/StagingRing.h"
+#include "src/core/StartupGraph.h"
+#include "src/core/ThreadPool.h"
+#include "src/core/VulkanDispatch.h"
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
@@ -26,6 +62,12 @@ const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// Optional: lets the frame pacer time submit -> present instead of submit -> GPU done
+const std::vector<const char*> presentWaitExtensions = {
+    VK_KHR_PRESENT_ID_EXTENSION_NAME,
+    VK_KHR_PRESENT_WAIT_EXTENSION_NAME
+};
+
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
 #else
@@ -33,9 +75,8 @@ const bool enableValidationLayers = true;
 #endif
 
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
-    auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
-    if (func != nullptr) {
-        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+    if (vki().vkCreateDebugUtilsMessengerEXT != nullptr) {
+        return vki().vkCreateDebugUtilsMessengerEXT(instance, pCreateInfo, pAllocator, pDebugMessenger);
     }
     else {
         return VK_ERROR_EXTENSION_NOT_PRESENT;
@@ -43,18 +84,20 @@ VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMes
 }
 
 void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
-    auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-    if (func != nullptr) {
-        func(instance, debugMessenger, pAllocator);
+    if (vki().vkDestroyDebugUtilsMessengerEXT != nullptr) {
+        vki().vkDestroyDebugUtilsMessengerEXT(instance, debugMessenger, pAllocator);
     }
 }
 
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Families without graphics, so their queues can run next to rendering; unset when the device has none
+    std::optional<uint32_t> transferFamily;
+    std::optional<uint32_t> computeFamily;
 
-    bool isComplete() {
-        return graphicsFamily.has_value() && presentFamily.has_value();
+    bool isComplete(bool needsPresent = true) {
+        return graphicsFamily.has_value() && (presentFamily.has_value() || !needsPresent);
     }
 };
 
@@ -64,16 +107,77 @@ struct SwapChainSupportDetails {
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+// Everything one frame in flight owns; the GPU may still be reading it until inFlightFence signals
+struct FrameResources {
+    VkCommandBuffer commandBuffer;
+    VkSemaphore imageAvailableSemaphore;
+    VkSemaphore renderFinishedSemaphore;
+    VkFence inFlightFence;
+};
+
 class HelloTriangleApplication {
 public:
+    explicit HelloTriangleApplication(const AppConfig& config) : config(config) {}
+
     void run() {
-        initWindow();
+        Profiler::get().setEnabled(config.profiler);
+        Profiler::get().setThreadName("main");
+        if (!config.headless) {
+            initWindow();
+        }
         initVulkan();
-        mainLoop();
+        if (config.benchmarkMesh) {
+            runMeshBenchmark();
+        }
+        else if (config.benchmarkAllocator) {
+            runAllocatorBenchmark();
+        }
+        else if (config.benchmarkDefrag) {
+            runDefragBenchmark();
+        }
+        else if (config.benchmarkUpload) {
+            runUploadBenchmark();
+        }
+        else if (config.benchmarkStreamMB > 0) {
+            runStreamBenchmark();
+        }
+        else if (config.benchmarkFrameAllocObjects > 0) {
+            runFrameAllocBenchmark();
+        }
+        else if (config.benchmarkReplace) {
+            runReplaceBenchmark();
+        }
+        else if (config.benchmarkResize) {
+            runResizeBenchmark();
+        }
+        else if (config.benchmarkRecordDraws > 0) {
+            runRecordBenchmark();
+        }
+        else if (config.benchmarkBundleDraws > 0) {
+            runBundleBenchmark();
+        }
+        else if (config.benchmarkDispatchDraws > 0) {
+            runDispatchBenchmark();
+        }
+        else if (config.benchmarkJobs) {
+            runJobsBenchmark();
+        }
+        else if (!config.benchmarkStartup) {
+            mainLoop();
+        }
+        else {
+            vkDeviceWaitIdle(device);
+        }
         cleanup();
+
+        if (!config.traceFile.empty()) {
+            Profiler::get().writeChromeTrace(config.traceFile);
+        }
     }
 
 private:
+    AppConfig config;
+
     GLFWwindow* window;
 
     VkInstance instance;
@@ -83,8 +187,21 @@ private:
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device;
 
+    // Every buffer and image memory comes from here
+    DeviceAllocator allocator;
+    // Replaced resources wait here until no frame in flight can use them
+    DeletionQueue deletionQueue;
+    // Compacts the allocator's blocks a few MB per frame
+    Defragmenter defragmenter;
+    // Every CPU -> GPU upload goes through here
+    StagingRing staging;
+    // Per-frame uniform data, picked per draw by dynamic offset
+    FrameArena frameArena;
+
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    VkQueue computeQueue = VK_NULL_HANDLE;
 
     VkSwapchainKHR swapChain;
     std::vector<VkImage> swapChainImages;
@@ -92,42 +209,189 @@ private:
     VkExtent2D swapChainExtent;
     std::vector<VkImageView> swapChainImageViews;
 
+    // Replaces the swapchain in headless mode; its views feed swapChainImageViews
+    OffscreenTarget offscreenTarget;
+
     VkRenderPass renderPass;
-    VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+
+    ShaderLibrary shaderLibrary;
+    ShaderCompiler shaderCompiler;
+    ShaderWatcher shaderWatcher;
+    ShaderModuleCache shaderModules;
+    DescriptorLayoutCache descriptorLayouts;
+    PipelineCache pipelineCache;
+    PipelineCompiler pipelineCompiler;
+    PipelineRegistry pipelineRegistry;
+    PipelineKey trianglePipeline;
+    std::unordered_map<std::string, PipelineKey> variantPipelines;
 
     VkCommandPool commandPool;
-    VkCommandBuffer commandBuffer;
+    ParallelRecorder recorder;
+    CommandBundle staticBundle;
+
+    GeometryBuffer geometry;
+    Mesh triangleMesh;
+    // What recordCommandBuffer draws; the mesh benchmark points these at its own buffer
+    GeometryBuffer* activeGeometry = &geometry;
+    Mesh activeMesh;
+    uint32_t drawRepeat = 1;
     std::vector<VkFramebuffer> swapChainFramebuffers;
 
-    VkSemaphore imageAvailableSemaphore;
-    VkSemaphore renderFinishedSemaphore;
-    VkFence inFlightFence;
+    std::vector<FrameResources> frames;
+    uint32_t currentFrame = 0;
+    uint64_t frameNumber = 0;
+
+    FrameStats frameStats;
+    FramePacer framePacer;
+
+    bool framebufferResized = false;
+    bool presentWaitEnabled = false;	// VK_KHR_present_id and VK_KHR_present_wait
+    uint64_t presentCount = 0;			// present ids only have to increase, so one count serves every swapchain
+    bool drawFromRefresh = false;	// only while the main loop is polling events, never from inside drawFrame()
 
     void initWindow() {
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
         window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+        glfwSetWindowRefreshCallback(window, windowRefreshCallback);
     }
 
-    void initVulkan() {
-        createInstance();
-        setupDebugMessenger();
-        createSurface();
-        pickPhysicalDevice();
-        createLogicalDevice();
-        createSwapChain();
-        createImageViews();
-        createRenderPass();
-        createGraphicsPipeline();
-        createFramebuffers();
-        createCommandPool();
-        createCommandBuffer();
-        createSyncObjects();
+    static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        app->framebufferResized = true;
+    }
 
+    // While the border is dragged, Windows keeps glfwPollEvents inside its modal resize loop; draw from there so
+    // the window follows the drag instead of freezing until the button is released
+    static void windowRefreshCallback(GLFWwindow* window) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        if (app->drawFromRefresh) {
+            // drawFrame() can wait for events itself (recreateSwapChain while minimized); no nested frame from there
+            app->drawFromRefresh = false;
+            app->drawFrame();
+            app->drawFromRefresh = true;
+        }
+    }
+
+    // Startup runs as a dependency graph, so shader compiles overlap instance and device creation and pipelines
+    // are described while the framebuffers are built. Stages that touch the window or start a JobSystem stay
+    // on this thread.
+    void initVulkan() {
+        PROFILE_SCOPE("initVulkan");
+        auto startupBegin = std::chrono::steady_clock::now();
+        auto pipelineBegin = startupBegin;
+
+        // Fixed before the first Vulkan call: every object is destroyed with the callbacks it was created with
+        HostAllocator::get().setEnabled(config.hostAllocator);
+
+        JobSystem startupJobs;
+        startupJobs.start(config.startupThreads);
+        StartupGraph startup;
+        QueueFamilyIndices families;
+
+        StartupGraph::Stage instanceStage = startup.add("instance", {}, [&] {
+            createInstance();
+            instanceDispatch.load(instance);
+            setupDebugMessenger();
+            if (!config.headless) {
+                createSurface();
+            }
+        });
+        StartupGraph::Stage deviceStage = startup.add("device", { instanceStage }, [&] {
+            pickPhysicalDevice();
+            createLogicalDevice();
+            if (config.dispatchTables) {
+                deviceDispatch.load(instanceDispatch, device);
+            }
+            else {
+                deviceDispatch.loadExports();
+            }
+            families = findQueueFamilies(physicalDevice);
+            framePacer.create(device, config.presentPolicy, config.fpsLimit, config.framesInFlight,
+                presentWaitEnabled && vkd().vkWaitForPresentKHR != nullptr);
+        });
+        StartupGraph::Stage memoryStage = startup.add("memory", { deviceStage }, [&] {
+            allocator.create(physicalDevice, device);
+            deletionQueue.create(&allocator);
+            defragmenter.create(&allocator, static_cast<VkDeviceSize>(config.defragBudgetKB) * 1024);
+            bool asyncUploads = config.transferQueue && families.transferFamily.has_value();
+            staging.create(&allocator, graphicsQueue, families.graphicsFamily.value(), static_cast<VkDeviceSize>(config.stagingRingMB) * 1024 * 1024,
+                asyncUploads ? transferQueue : VK_NULL_HANDLE, families.transferFamily.value_or(0), config.framesInFlight);
+            frameArena.create(&allocator, static_cast<VkDeviceSize>(config.frameArenaKB) * 1024, config.framesInFlight);
+            if (config.profiler) {
+                Profiler::get().createGpu(physicalDevice, device, graphicsQueue, families.graphicsFamily.value(), config.framesInFlight);
+            }
+        });
+        StartupGraph::Stage targetStage = config.headless
+            ? startup.add("offscreen target", { memoryStage }, [&] { createOffscreenTarget(); })
+            : startup.addMainThread("swap chain", { deviceStage }, [&] {
+                createSwapChain();
+                createImageViews();
+            });
+        StartupGraph::Stage renderPassStage = startup.add("render pass", { targetStage }, [&] { createRenderPass(); });
+        StartupGraph::Stage cacheStage = startup.add("pipeline cache", { deviceStage }, [&] {
+            pipelineCache.create(physicalDevice, device, config.pipelineCachePath);
+        });
+        // Needs no device: GLSL compiles and SPIR-V reads run next to instance and device creation
+        StartupGraph::Stage shaderStage = startup.add("shaders", {}, [&] {
+            if (useShaderSources()) {
+                shaderCompiler.create(config.shaderCacheDir);
+            }
+            shaderModules.create(&shaderLibrary, &shaderCompiler);
+            prefetchShaders(startupJobs);
+        });
+        startup.add("pipelines", { deviceStage, renderPassStage, cacheStage, shaderStage }, [&] {
+            shaderModules.setDevice(device);
+            pipelineCompiler.create(device, pipelineCache.get(), &shaderModules, config.pipelineThreads);
+            pipelineRegistry.create(device, &pipelineCompiler);
+            descriptorLayouts.create(device);
+
+            pipelineBegin = std::chrono::steady_clock::now();
+            createGraphicsPipeline();
+            createVariantPipelines();
+        });
+        startup.add("framebuffers", { renderPassStage }, [&] { createFramebuffers(); });
+        // The recorder starts its JobSystem here, and that makes this thread its worker 0
+        startup.addMainThread("commands", { memoryStage }, [&] {
+            createCommandPool();
+            if (config.recordThreads > 0) {
+                recorder.create(device, families.graphicsFamily.value(), config.recordThreads, config.framesInFlight);
+            }
+            if (config.commandBundles) {
+                staticBundle.create(device, families.graphicsFamily.value(), &deletionQueue);
+            }
+            createGeometry();
+            createCommandBuffers();
+            createSyncObjects();
+        });
+
+        startup.run(startupJobs);
+        startupJobs.stop();
+
+        if (config.benchmarkStartup) {
+            auto initEnd = std::chrono::steady_clock::now();
+            pipelineCompiler.waitIdle();
+            auto pipelineEnd = std::chrono::steady_clock::now();
+
+            using ms = std::chrono::duration<double, std::milli>;
+            printf("startup: %.2f ms, all pipelines ready after %.2f ms (pipeline cache %s, %zu bytes loaded)\n",
+                ms(initEnd - startupBegin).count(),
+                ms(pipelineEnd - pipelineBegin).count(),
+                pipelineCache.wasWarm() ? "warm" : "cold",
+                pipelineCache.loadedSize());
+            startup.printReport();
+            pipelineCompiler.printTimings();
+            pipelineRegistry.printStats();
+            shaderModules.printStats();
+            if (useShaderSources()) {
+                printf("shader compiler: %u compiled, %u from cache\n", shaderCompiler.compiledCount(), shaderCompiler.cachedCount());
+            }
+        }
     }
 
 
@@ -139,23 +403,34 @@ private:
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFence) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create semaphores!");
+        for (FrameResources& frame : frames) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, hostCallbacks(), &frame.imageAvailableSemaphore) != VK_SUCCESS ||
+                vkCreateSemaphore(device, &semaphoreInfo, hostCallbacks(), &frame.renderFinishedSemaphore) != VK_SUCCESS ||
+                vkCreateFence(device, &fenceInfo, hostCallbacks(), &frame.inFlightFence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create semaphores!");
+            }
         }
 
     }
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) 
     {
+        PROFILE_SCOPE("recordCommandBuffer");
+
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.flags = 0; // Optional
         beginInfo.pInheritanceInfo = nullptr; // Optional
 
-        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        if (vkd().vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
             throw std::runtime_error("failed to begin recording command buffer!");
         }
+        Profiler::get().beginGpuFrame(commandBuffer, currentFrame);
+
+        // Uploads, then relocations, so everything below sees both the new data and the patched handles
+        uint32_t uploadScope = Profiler::get().beginGpuScope(commandBuffer, "uploads");
+        staging.record(commandBuffer);
+        defragmenter.record(commandBuffer);
+        Profiler::get().endGpuScope(commandBuffer, uploadScope);
 
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -169,9 +444,49 @@ private:
         renderPassInfo.clearValueCount = 1;
         renderPassInfo.pClearValues = &clearColor;
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        VkCommandBufferInheritanceInfo inheritance{};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = renderPass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = swapChainFramebuffers[imageIndex];
+
+        uint32_t renderPassScope = Profiler::get().beginGpuScope(commandBuffer, "render pass");
+        // A pass with secondary contents takes nothing but vkCmdExecuteCommands, so there the "draw" scope
+        // spans the whole pass (a reused bundle can't hold this frame's queries either)
+        bool secondaryContents = config.commandBundles || config.recordThreads > 0;
+        uint32_t drawScope = secondaryContents ? Profiler::get().beginGpuScope(commandBuffer, "draw") : UINT32_MAX;
+        // --record-threads turns bundles off, so the recorder is only ever created for the path below
+        if (config.commandBundles) {
+            // Nothing in the pass changes between frames unless sceneKey() does
+            vkd().vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            VkCommandBuffer bundle = staticBundle.get(imageIndex, inheritance, sceneKey(),
+                [this](VkCommandBuffer secondary) { recordDraw(secondary); });
+            vkd().vkCmdExecuteCommands(commandBuffer, 1, &bundle);
+        }
+        else if (config.recordThreads > 0) {
+            vkd().vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            const std::vector<VkCommandBuffer>& secondaries = recorder.record(inheritance, 1,
+                [this](VkCommandBuffer secondary, uint32_t, uint32_t) { recordDraw(secondary); });
+            vkd().vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+        }
+        else {
+            vkd().vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            PROFILE_GPU_SCOPE(commandBuffer, "draw");
+            recordDraw(commandBuffer);
+        }
+
+        vkd().vkCmdEndRenderPass(commandBuffer);
+        Profiler::get().endGpuScope(commandBuffer, drawScope);
+        Profiler::get().endGpuScope(commandBuffer, renderPassScope);
+
+        if (vkd().vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
 
+    }
+
+    // Everything inside the render pass; also recorded into secondaries, so it sets its own dynamic state
+    void recordDraw(VkCommandBuffer commandBuffer) {
         VkViewport viewport{};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
@@ -179,33 +494,59 @@ private:
         viewport.height = static_cast<float>(swapChainExtent.height);
         viewport.minDepth = 0.0f;
         viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkd().vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
         VkRect2D scissor{};
         scissor.offset = { 0, 0 };
         scissor.extent = swapChainExtent;
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-        vkCmdEndRenderPass(commandBuffer);
-
-        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
+        vkd().vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        // Skip the draw while the pipeline is still compiling
+        const RegisteredPipeline* triangle = pipelineRegistry.find(trianglePipeline);
+        VkPipeline pipeline = pipelineCompiler.getIfReady(triangle->pipeline);
+        if (pipeline != VK_NULL_HANDLE) {
+            vkd().vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            activeGeometry->bind(commandBuffer);
+            for (uint32_t i = 0; i < drawRepeat; i++) {
+                GeometryBuffer::draw(commandBuffer, activeMesh);
+            }
+        }
+        else if (pipelineCompiler.getState(triangle->pipeline) == PipelineState::Failed) {
+            throw std::runtime_error(pipelineCompiler.getError(triangle->pipeline));
         }
+    }
 
+    // Everything recordDraw() bakes into its commands: a pipeline finishing or being rebuilt, the defragmenter
+    // moving the geometry, another mesh or draw count all re-record the bundle
+    uint64_t sceneKey() {
+        VkPipeline pipeline = pipelineCompiler.getIfReady(pipelineRegistry.find(trianglePipeline)->pipeline);
+        uint64_t key = hashCombine(0, pipeline);
+        key = hashCombine(key, activeGeometry->getVertexBuffer());
+        key = hashCombine(key, activeGeometry->getIndexBuffer());
+        key = hashCombine(key, activeMesh);
+        key = hashCombine(key, drawRepeat);
+        return hashCombine(key, swapChainExtent);
     }
 
-    void createCommandBuffer()
+    void createCommandBuffers()
     {
+        frames.resize(config.framesInFlight);
+
+        std::vector<VkCommandBuffer> commandBuffers(frames.size());
+
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.commandPool = commandPool;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 1;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 
-        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate command buffers!");
         }
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            frames[i].commandBuffer = commandBuffers[i];
+        }
     }
 
     void createCommandPool() 
@@ -217,87 +558,1020 @@ private:
         poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
         poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        if (vkCreateCommandPool(device, &poolInfo, hostCallbacks(), &commandPool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create command pool!");
         }
     }
 
-    void mainLoop() {
-        while (!glfwWindowShouldClose(window)) {
+    void createGeometry() {
+        geometry.create(&allocator, &staging, sizeof(MeshVertex), 65536, 3 * 65536);
+        geometry.makeMovable(&defragmenter);
+
+        // The first frame records the copies before its draw
+        MeshData triangle = makeTriangleMesh();
+        triangleMesh = geometry.upload(triangle.vertices.data(), static_cast<uint32_t>(triangle.vertices.size()),
+            triangle.indices.data(), static_cast<uint32_t>(triangle.indices.size()));
+        activeMesh = triangleMesh;
+    }
+
+    // Draws grids from 1K triangles up to meshBenchmarkMaxTriangles (x10 each step) for about a second each.
+    // With a window every frame is vsync-limited, so run it --headless for raw throughput.
+    void runMeshBenchmark() {
+        using ms = std::chrono::duration<double, std::milli>;
+
+        pipelineCompiler.waitIdle();
+        frameStats.begin();
+        if (!config.headless) {
+            printf("note: presenting is vsync-limited, use --headless for raw throughput\n");
+        }
+
+        for (uint64_t target = 1000; target <= config.meshBenchmarkMaxTriangles; target *= 10) {
+            MeshData grid = makeGridMesh(static_cast<uint32_t>(target));
+
+            GeometryBuffer benchGeometry;
+            benchGeometry.create(&allocator, &staging, sizeof(MeshVertex), static_cast<uint32_t>(grid.vertices.size()), static_cast<uint32_t>(grid.indices.size()));
+            auto uploadStart = std::chrono::steady_clock::now();
+            activeMesh = benchGeometry.upload(grid.vertices.data(), static_cast<uint32_t>(grid.vertices.size()),
+                grid.indices.data(), static_cast<uint32_t>(grid.indices.size()));
+            staging.flush();
+            double uploadMs = ms(std::chrono::steady_clock::now() - uploadStart).count();
+            activeGeometry = &benchGeometry;
+
+            for (int i = 0; i < 10; i++) {
+                drawFrame();
+            }
+            vkDeviceWaitIdle(device);
+
+            auto start = std::chrono::steady_clock::now();
+            uint32_t frameCount = 0;
+            while (frameCount < 10 || (ms(std::chrono::steady_clock::now() - start).count() < 1000.0 && frameCount < 10000)) {
+                if (!config.headless) {
+                    glfwPollEvents();
+                }
+                drawFrame();
+                frameCount++;
+            }
+            vkDeviceWaitIdle(device);
+            double elapsedMs = ms(std::chrono::steady_clock::now() - start).count();
+
+            double trianglesPerSecond = static_cast<double>(grid.triangleCount()) * frameCount / (elapsedMs / 1000.0);
+            printf("%10u triangles: %8.3f ms/frame, %9.1f Mtri/s (uploaded %.1f MB in %.2f ms)\n",
+                grid.triangleCount(), elapsedMs / frameCount, trianglesPerSecond / 1e6,
+                benchGeometry.bytesUploaded() / (1024.0 * 1024.0), uploadMs);
+
+            activeGeometry = &geometry;
+            activeMesh = triangleMesh;
+            benchGeometry.destroy();
+        }
+
+        allocator.printStats();
+    }
+
+    // Allocate/free churn through the sub-allocator vs straight vkAllocateMemory/vkFreeMemory.
+    // Keeps allocatorBenchmarkLive allocations of 256 B .. 1 MB (log-uniform) alive and replaces a random one per step.
+    void runAllocatorBenchmark() {
+        using ms = std::chrono::duration<double, std::milli>;
+
+        const uint32_t live = config.allocatorBenchmarkLive;
+        const uint32_t steps = 500000;
+        const uint32_t rawSteps = 20000;
+
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<double> log2Size(8.0, 20.0);
+        std::vector<VkDeviceSize> sizes(live + steps);
+        std::vector<uint32_t> victims(steps);
+        for (VkDeviceSize& size : sizes) {
+            size = static_cast<VkDeviceSize>(std::exp2(log2Size(rng)));
+        }
+        for (uint32_t& victim : victims) {
+            victim = static_cast<uint32_t>(rng() % live);
+        }
+
+        VkMemoryRequirements requirements{};
+        requirements.alignment = 256;
+        requirements.memoryTypeBits = ~0u;
+
+        std::vector<Allocation> allocations(live);
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < live; i++) {
+            requirements.size = sizes[i];
+            allocations[i] = allocator.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceKind::Linear);
+        }
+        for (uint32_t i = 0; i < steps; i++) {
+            Allocation& victim = allocations[victims[i]];
+            allocator.free(victim);
+            requirements.size = sizes[live + i];
+            victim = allocator.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceKind::Linear);
+        }
+        double subMs = ms(std::chrono::steady_clock::now() - start).count();
+        uint32_t subDeviceAllocations = allocator.deviceAllocationCount();
+        allocator.printStats();
+
+        uint32_t memoryType = allocations[0].memoryType;
+        for (const Allocation& allocation : allocations) {
+            allocator.free(allocation);
+        }
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        if (live + allocator.deviceAllocationCount() > properties.limits.maxMemoryAllocationCount) {
+            throw std::runtime_error("--bench-alloc-live exceeds maxMemoryAllocationCount!");
+        }
+
+        std::vector<VkDeviceMemory> memories(live);
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < live; i++) {
+            allocInfo.allocationSize = sizes[i];
+            if (vkAllocateMemory(device, &allocInfo, hostCallbacks(), &memories[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate memory!");
+            }
+        }
+        for (uint32_t i = 0; i < rawSteps; i++) {
+            VkDeviceMemory& victim = memories[victims[i]];
+            vkFreeMemory(device, victim, hostCallbacks());
+            allocInfo.allocationSize = sizes[live + i];
+            if (vkAllocateMemory(device, &allocInfo, hostCallbacks(), &victim) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate memory!");
+            }
+        }
+        double rawMs = ms(std::chrono::steady_clock::now() - start).count();
+        for (VkDeviceMemory memory : memories) {
+            vkFreeMemory(device, memory, hostCallbacks());
+        }
+
+        // One op = one allocate or one free
+        double subOps = 2.0 * steps + live;
+        double rawOps = 2.0 * rawSteps + live;
+        printf("allocator churn, %u live, 256 B .. 1 MB:\n", live);
+        printf("  sub-allocator:    %10.0f ops/s (%7.1f ns/op) over %u device allocations\n",
+            subOps / (subMs / 1000.0), subMs * 1e6 / subOps, subDeviceAllocations);
+        printf("  vkAllocateMemory: %10.0f ops/s (%7.1f ns/op) over %u device allocations\n",
+            rawOps / (rawMs / 1000.0), rawMs * 1e6 / rawOps, live);
+    }
+
+    // Fills a few blocks with buffers of 4 KB .. 1 MB, frees 70% of them at random, then draws frames until the
+    // defragmenter has nothing left to compact. Tune the per-frame cost with --defrag-budget.
+    void runDefragBenchmark() {
+        using ms = std::chrono::duration<double, std::milli>;
+
+        const VkDeviceSize totalBytes = 3 * allocator.getBlockSize();
+        const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        struct TestBuffer {
+            VkBuffer buffer;
+            Allocation allocation;
+            VkDeviceSize size;
+        };
+
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<double> log2Size(12.0, 20.0);
+        std::vector<VkDeviceSize> sizes;
+        for (VkDeviceSize total = 0; total < totalBytes;) {
+            sizes.push_back(static_cast<VkDeviceSize>(std::exp2(log2Size(rng))));
+            total += sizes.back();
+        }
+
+        // The defragmenter keeps pointers into this vector, so it never grows after this
+        std::vector<TestBuffer> buffers(sizes.size());
+        for (size_t i = 0; i < buffers.size(); i++) {
+            buffers[i].size = sizes[i];
+            allocator.createBuffer(sizes[i], usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers[i].buffer, buffers[i].allocation);
+            defragmenter.addBuffer(&buffers[i].buffer, &buffers[i].allocation, sizes[i], usage);
+        }
+
+        std::vector<bool> alive(buffers.size(), true);
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (rng() % 10 < 7) {
+                defragmenter.remove(&buffers[i].allocation);
+                allocator.destroyBuffer(buffers[i].buffer, buffers[i].allocation);
+                alive[i] = false;
+            }
+        }
+
+        printf("before:\n");
+        allocator.printStats();
+
+        pipelineCompiler.waitIdle();
+        auto start = std::chrono::steady_clock::now();
+        uint32_t frameCount = 0;
+        while (!defragmenter.idle() && frameCount < 100000) {
+            if (!config.headless) {
+                glfwPollEvents();
+            }
+            drawFrame();
+            frameCount++;
+        }
+        vkDeviceWaitIdle(device);
+        double elapsedMs = ms(std::chrono::steady_clock::now() - start).count();
+
+        printf("after %u frames (%.1f ms):\n", frameCount, elapsedMs);
+        allocator.printStats();
+        defragmenter.printStats();
+
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (alive[i]) {
+                defragmenter.remove(&buffers[i].allocation);
+                allocator.destroyBuffer(buffers[i].buffer, buffers[i].allocation);
+            }
+        }
+    }
+
+    // Upload throughput for 64 B .. 64 MB uploads scattered over a 64 MB buffer: through the staging ring
+    // (about 256 MB per size, flushed every half ring) vs a fresh host-visible buffer, map, submit and wait per upload.
+    void runUploadBenchmark() {
+        using ms = std::chrono::duration<double, std::milli>;
+        const VkDeviceSize MB = 1024 * 1024;
+        const VkDeviceSize dstSize = 64 * MB;
+
+        VkBuffer dst;
+        Allocation dstMemory;
+        allocator.createBuffer(dstSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, dst, dstMemory);
+
+        std::vector<char> data(static_cast<size_t>(dstSize));
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<char>(i * 31);
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        if (vkCreateFence(device, &fenceInfo, hostCallbacks(), &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create fence!");
+        }
+
+        printf("%10s %14s %14s %10s\n", "size", "ring MB/s", "naive MB/s", "regions");
+        for (VkDeviceSize size = 64; size <= dstSize; size *= 4) {
+            // Coprime stride, so a batch never writes the same slot twice and neighbours rarely merge
+            const uint64_t slots = dstSize / size;
+            auto slotOffset = [&](uint64_t i) { return ((i * 7919) % slots) * size; };
+
+            uint64_t count = std::max<uint64_t>(1, 256 * MB / size);
+            StagingStats before = staging.getStats();
+            auto start = std::chrono::steady_clock::now();
+            VkDeviceSize batch = 0;
+            for (uint64_t i = 0; i < count; i++) {
+                staging.uploadBuffer(dst, slotOffset(i), data.data(), size);
+                batch += size;
+                if (batch >= staging.getCapacity() / 2) {
+                    staging.flush();
+                    batch = 0;
+                }
+            }
+            staging.flush();
+            double ringMs = ms(std::chrono::steady_clock::now() - start).count();
+            uint32_t regions = staging.getStats().regions - before.regions;
+
+            uint64_t naiveCount = std::min<uint64_t>(count, 1000);
+            start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < naiveCount; i++) {
+                naiveUpload(dst, slotOffset(i), data.data(), size, fence);
+            }
+            double naiveMs = ms(std::chrono::steady_clock::now() - start).count();
+
+            printf("%10llu %14.1f %14.1f %10u\n", static_cast<unsigned long long>(size),
+                (count * size) / (ringMs / 1000.0) / MB, (naiveCount * size) / (naiveMs / 1000.0) / MB, regions);
+        }
+
+        const StagingStats& stats = staging.getStats();
+        printf("staging ring: %u uploads in %u copy commands, %u flushes, %u stalls\n", stats.uploads, stats.copyCommands, stats.flushes, stats.stalls);
+
+        vkDestroyFence(device, fence, hostCallbacks());
+        allocator.destroyBuffer(dst, dstMemory);
+    }
+
+    // Streams benchmarkStreamMB per frame into a 256 MB buffer while drawing a 1M triangle grid, then prints frame
+    // times and how long the transfer queue was busy. Run it again with --no-transfer-queue: the frame time saved
+    // is the copying that overlapped rendering (timestamps from two queues can't be compared to measure it).
+    void runStreamBenchmark() {
+        const VkDeviceSize MB = 1024 * 1024;
+        const VkDeviceSize targetSize = 256 * MB;
+        const VkDeviceSize chunk = std::min<VkDeviceSize>(static_cast<VkDeviceSize>(config.benchmarkStreamMB) * MB, targetSize);
+
+        pipelineCompiler.waitIdle();
+
+        MeshData grid = makeGridMesh(1000000);
+        GeometryBuffer benchGeometry;
+        benchGeometry.create(&allocator, &staging, sizeof(MeshVertex), static_cast<uint32_t>(grid.vertices.size()), static_cast<uint32_t>(grid.indices.size()));
+        activeMesh = benchGeometry.upload(grid.vertices.data(), static_cast<uint32_t>(grid.vertices.size()),
+            grid.indices.data(), static_cast<uint32_t>(grid.indices.size()));
+        staging.flush();
+        activeGeometry = &benchGeometry;
+
+        VkBuffer target;
+        Allocation targetMemory;
+        allocator.createBuffer(targetSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target, targetMemory);
+        std::vector<char> data(static_cast<size_t>(chunk), 1);
+        uint64_t slices = targetSize / chunk;
+
+        printf("streaming %.0f MB per frame on the %s queue\n", chunk / double(MB), staging.usesTransferQueue() ? "transfer" : "graphics");
+        for (uint32_t i = 0; i < 10; i++) {
+            drawFrame();
+        }
+        vkDeviceWaitIdle(device);
+
+        frameStats.begin();
+        StagingStats before = staging.getStats();
+        for (uint64_t i = 0; i < 300; i++) {
+            if (!config.headless) {
+                glfwPollEvents();
+            }
+            staging.uploadBuffer(target, (i % slices) * chunk, data.data(), chunk);
+            drawFrame();
+        }
+        vkDeviceWaitIdle(device);
+
+        frameStats.print(config.framesInFlight);
+        const StagingStats& after = staging.getStats();
+        if (after.transferMs > before.transferMs) {
+            double busy = after.transferMs - before.transferMs;
+            printf("transfer queue: %.2f ms busy over %u batches\n", busy, after.transferBatches - before.transferBatches);
+        }
+        staging.printStats();
+
+        activeGeometry = &geometry;
+        activeMesh = triangleMesh;
+        allocator.destroyBuffer(target, targetMemory);
+        benchGeometry.destroy();
+    }
+
+    // CPU cost of per-object constants for benchmarkFrameAllocObjects objects a frame: FrameArena writers on every core
+    // and on one thread vs a fresh host-visible uniform buffer per object, destroyed once its frame slot comes round.
+    // Nothing is drawn; the arena's own slots are reset without waiting on fences.
+    void runFrameAllocBenchmark() {
+        using ms = std::chrono::duration<double, std::milli>;
+        struct ObjectConstants {
+            float model[16];
+            float normal[12];
+            float color[4];
+        };
+        const uint32_t objects = config.benchmarkFrameAllocObjects;
+        const uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+        const uint32_t arenaFrames = 200;
+
+        auto fill = [](ObjectConstants& c, uint32_t object, uint32_t frame) {
+            for (uint32_t i = 0; i < 16; i++) {
+                c.model[i] = static_cast<float>(object + i * frame);
+            }
+            for (uint32_t i = 0; i < 12; i++) {
+                c.normal[i] = static_cast<float>(object * i);
+            }
+            for (uint32_t i = 0; i < 4; i++) {
+                c.color[i] = static_cast<float>(frame + i);
+            }
+        };
+
+        FrameArena arena;
+        const VkDeviceSize chunkSize = 16 * 1024;
+        arena.create(&allocator, objects * std::max<VkDeviceSize>(sizeof(ObjectConstants), 256) + (threads + 1) * chunkSize,
+            config.framesInFlight, chunkSize);
+
+        ThreadPool pool;
+        pool.start(threads);
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < arenaFrames; frame++) {
+            arena.beginFrame(frame % config.framesInFlight);
+            for (uint32_t t = 0; t < threads; t++) {
+                pool.submit([&, t, frame] {
+                    FrameArena::Writer writer = arena.writer();
+                    ObjectConstants c;
+                    for (uint32_t i = t; i < objects; i += threads) {
+                        fill(c, i, frame);
+                        writer.write(c);
+                    }
+                });
+            }
+            pool.waitIdle();
+        }
+        double threadedMs = ms(std::chrono::steady_clock::now() - start).count() / arenaFrames;
+        pool.stop();
+
+        start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < arenaFrames; frame++) {
+            arena.beginFrame(frame % config.framesInFlight);
+            FrameArena::Writer writer = arena.writer();
+            ObjectConstants c;
+            for (uint32_t i = 0; i < objects; i++) {
+                fill(c, i, frame);
+                writer.write(c);
+            }
+        }
+        double singleMs = ms(std::chrono::steady_clock::now() - start).count() / arenaFrames;
+        VkDeviceSize peak = arena.getPeakBytes();
+        arena.destroy();
+
+        struct ObjectBuffer {
+            VkBuffer buffer;
+            Allocation memory;
+        };
+        const uint32_t bufferFrames = 20;
+        std::vector<std::vector<ObjectBuffer>> slots(config.framesInFlight);
+        start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < bufferFrames; frame++) {
+            std::vector<ObjectBuffer>& slot = slots[frame % config.framesInFlight];
+            for (ObjectBuffer& b : slot) {
+                allocator.destroyBuffer(b.buffer, b.memory);
+            }
+            slot.resize(objects);
+            ObjectConstants c;
+            for (uint32_t i = 0; i < objects; i++) {
+                allocator.createBuffer(sizeof(ObjectConstants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, slot[i].buffer, slot[i].memory);
+                fill(c, i, frame);
+                memcpy(slot[i].memory.mapped, &c, sizeof(c));
+            }
+        }
+        double bufferMs = ms(std::chrono::steady_clock::now() - start).count() / bufferFrames;
+        for (std::vector<ObjectBuffer>& slot : slots) {
+            for (ObjectBuffer& b : slot) {
+                allocator.destroyBuffer(b.buffer, b.memory);
+            }
+        }
+
+        printf("%u objects x %zu B per frame, arena peak %.1f KB\n", objects, sizeof(ObjectConstants), peak / 1024.0);
+        printf("%-28s %12s %16s\n", "method", "ms/frame", "objects/ms");
+        printf("%-28s %12.3f %16.0f\n", ("arena, " + std::to_string(threads) + " threads").c_str(), threadedMs, objects / threadedMs);
+        printf("%-28s %12.3f %16.0f\n", "arena, 1 thread", singleMs, objects / singleMs);
+        printf("%-28s %12.3f %16.0f\n", "buffer per object", bufferMs, objects / bufferMs);
+    }
+
+    // Replaces the drawn 100K triangle grid with a freshly uploaded copy every 4th frame, retiring the old buffers
+    // through the deletion queue, then again with a vkDeviceWaitIdle before each destroy, and prints both frame times.
+    void runReplaceBenchmark() {
+        const uint32_t frameCount = 400;
+        const uint32_t replaceEvery = 4;
+
+        pipelineCompiler.waitIdle();
+        MeshData grid = makeGridMesh(100000);
+
+        for (int deferred = 1; deferred >= 0; deferred--) {
+            std::shared_ptr<GeometryBuffer> current;
+            frameStats.begin();
+            for (uint32_t i = 0; i < frameCount; i++) {
+                if (!config.headless) {
+                    glfwPollEvents();
+                }
+                if (i % replaceEvery == 0) {
+                    auto next = std::make_shared<GeometryBuffer>();
+                    next->create(&allocator, &staging, sizeof(MeshVertex), static_cast<uint32_t>(grid.vertices.size()), static_cast<uint32_t>(grid.indices.size()));
+                    activeMesh = next->upload(grid.vertices.data(), static_cast<uint32_t>(grid.vertices.size()),
+                        grid.indices.data(), static_cast<uint32_t>(grid.indices.size()));
+                    activeGeometry = next.get();
+
+                    if (current && deferred) {
+                        deletionQueue.push([current] { current->destroy(); });
+                    }
+                    else if (current) {
+                        vkDeviceWaitIdle(device);
+                        current->destroy();
+                    }
+                    current = next;
+                }
+                drawFrame();
+            }
+            vkDeviceWaitIdle(device);
+
+            printf("%s:\n", deferred ? "deletion queue" : "vkDeviceWaitIdle per replacement");
+            frameStats.print(config.framesInFlight);
+            activeGeometry = &geometry;
+            activeMesh = triangleMesh;
+            current->destroy();
+        }
+
+        const DeletionStats& stats = deletionQueue.getStats();
+        printf("deletion queue: %llu queued, %llu destroyed, at most %u pending\n", static_cast<unsigned long long>(stats.queued),
+            static_cast<unsigned long long>(stats.destroyed), stats.maxPending);
+    }
+
+    // Resizes the window every frame between 640x480 and 1280x960, the way a border drag does, for 300 frames and
+    // prints frame times with the worst frame and what the swapchain recreations cost
+    void runResizeBenchmark() {
+        if (config.headless) {
+            throw std::runtime_error("--bench-resize needs a window!");
+        }
+
+        pipelineCompiler.waitIdle();
+        frameStats.begin();
+        for (uint32_t i = 0; i < 300; i++) {
+            double t = 0.5 + 0.5 * std::sin(i * 0.1);
+            glfwSetWindowSize(window, 640 + static_cast<int>(640 * t), 480 + static_cast<int>(480 * t));
             glfwPollEvents();
             drawFrame();
         }
+        vkDeviceWaitIdle(device);
+        frameStats.print(config.framesInFlight);
+    }
+
+    // CPU cost of recording benchmarkRecordDraws draws into secondaries on 1, 2, 4 .. core count threads. Only
+    // recorded, never submitted, so no image has to be acquired and the pools can be reset straight away.
+    void runRecordBenchmark() {
+        using ms = std::chrono::duration<double, std::milli>;
+        const uint32_t draws = config.benchmarkRecordDraws;
+        const uint32_t frameCount = 50;
+        const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+        pipelineCompiler.waitIdle();
+        VkPipeline pipeline = pipelineCompiler.getIfReady(pipelineRegistry.find(trianglePipeline)->pipeline);
+        if (pipeline == VK_NULL_HANDLE) {
+            throw std::runtime_error("triangle pipeline failed to compile!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer primary;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &primary) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        VkCommandBufferInheritanceInfo inheritance{};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = renderPass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = swapChainFramebuffers[0];
+
+        auto recordRange = [&](VkCommandBuffer commandBuffer, uint32_t, uint32_t count) {
+            VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height), 0.0f, 1.0f };
+            VkRect2D scissor{ { 0, 0 }, swapChainExtent };
+            vkd().vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vkd().vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            vkd().vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            geometry.bind(commandBuffer);
+            for (uint32_t i = 0; i < count; i++) {
+                GeometryBuffer::draw(commandBuffer, triangleMesh);
+            }
+        };
+
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t t = 1; t < cores; t *= 2) {
+            threadCounts.push_back(t);
+        }
+        threadCounts.push_back(cores);
+
+        printf("%u draws per frame, %u frames per thread count\n", draws, frameCount);
+        printf("%-10s %12s %16s %10s\n", "threads", "ms/frame", "draws/sec", "speedup");
+        double singleMs = 0.0;
+        for (uint32_t threads : threadCounts) {
+            ParallelRecorder benchRecorder;
+            benchRecorder.create(device, findQueueFamilies(physicalDevice).graphicsFamily.value(), threads, 1);
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; frame < frameCount; frame++) {
+                benchRecorder.beginFrame(0);
+                vkd().vkResetCommandBuffer(primary, 0);
+
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                vkd().vkBeginCommandBuffer(primary, &beginInfo);
+
+                VkRenderPassBeginInfo renderPassInfo{};
+                renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                renderPassInfo.renderPass = renderPass;
+                renderPassInfo.framebuffer = swapChainFramebuffers[0];
+                renderPassInfo.renderArea.extent = swapChainExtent;
+                VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+                renderPassInfo.clearValueCount = 1;
+                renderPassInfo.pClearValues = &clearColor;
+                vkd().vkCmdBeginRenderPass(primary, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+                const std::vector<VkCommandBuffer>& secondaries = benchRecorder.record(inheritance, draws, recordRange);
+                vkd().vkCmdExecuteCommands(primary, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+                vkd().vkCmdEndRenderPass(primary);
+                vkd().vkEndCommandBuffer(primary);
+            }
+            double frameMs = ms(std::chrono::steady_clock::now() - start).count() / frameCount;
+            benchRecorder.destroy();
+
+            if (threads == 1) {
+                singleMs = frameMs;
+            }
+            printf("%-10u %12.3f %16.0f %9.2fx\n", threads, frameMs, draws * 1000.0 / frameMs, singleMs / frameMs);
+        }
+
+        vkFreeCommandBuffers(device, commandPool, 1, &primary);
+    }
+
+    // Records benchmarkDispatchDraws draws into one command buffer, calling through a table of the loader's exports
+    // and through the device table, alternating so both see the same driver state. Only recording is timed;
+    // nothing is submitted.
+    void runDispatchBenchmark() {
+        using ms = std::chrono::duration<double, std::milli>;
+        const uint32_t draws = config.benchmarkDispatchDraws;
+        const uint32_t calls = 2 * draws + 9;
+        const uint32_t rounds = 20;
+
+        pipelineCompiler.waitIdle();
+        VkPipeline pipeline = pipelineCompiler.getIfReady(pipelineRegistry.find(trianglePipeline)->pipeline);
+        if (pipeline == VK_NULL_HANDLE) {
+            throw std::runtime_error("triangle pipeline failed to compile!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        DeviceDispatch exports;
+        exports.loadExports();
+        DeviceDispatch direct;
+        direct.load(instanceDispatch, device);
+
+        auto record = [&](const DeviceDispatch& vk) {
+            auto start = std::chrono::steady_clock::now();
+            vk.vkResetCommandBuffer(commandBuffer, 0);
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            vk.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = renderPass;
+            renderPassInfo.framebuffer = swapChainFramebuffers[0];
+            renderPassInfo.renderArea.extent = swapChainExtent;
+            VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+            renderPassInfo.clearValueCount = 1;
+            renderPassInfo.pClearValues = &clearColor;
+            vk.vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+            VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height), 0.0f, 1.0f };
+            VkRect2D scissor{ { 0, 0 }, swapChainExtent };
+            vk.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            vk.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            VkBuffer vertexBuffer = geometry.getVertexBuffer();
+            VkDeviceSize offset = 0;
+            vk.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+            vk.vkCmdBindIndexBuffer(commandBuffer, geometry.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+            // A state change and a draw each time, like a scene that sets a scissor per object
+            for (uint32_t i = 0; i < draws; i++) {
+                vk.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+                vk.vkCmdDrawIndexed(commandBuffer, triangleMesh.indexCount, 1, triangleMesh.firstIndex, triangleMesh.vertexOffset, 0);
+            }
+
+            vk.vkCmdEndRenderPass(commandBuffer);
+            vk.vkEndCommandBuffer(commandBuffer);
+            return ms(std::chrono::steady_clock::now() - start).count();
+        };
+
+        // One of each first, so neither pays for growing the command buffer
+        record(exports);
+        record(direct);
+        double exportsMs = 0.0;
+        double directMs = 0.0;
+        for (uint32_t i = 0; i < rounds; i++) {
+            exportsMs += record(exports);
+            directMs += record(direct);
+        }
+        exportsMs /= rounds;
+        directMs /= rounds;
+
+        printf("%u draws (%u calls) per command buffer, %u command buffers each\n", draws, calls, rounds);
+        printf("%-16s %12s %16s %10s\n", "calls through", "ms/buffer", "draws/sec", "ns/call");
+        printf("%-16s %12.3f %16.0f %10.2f\n", "loader exports", exportsMs, draws * 1000.0 / exportsMs, exportsMs * 1e6 / calls);
+        printf("%-16s %12.3f %16.0f %10.2f\n", "device table", directMs, draws * 1000.0 / directMs, directMs * 1e6 / calls);
+        printf("device table: %.2fx\n", exportsMs / directMs);
+
+        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    }
+
+    // A static scene of benchmarkBundleDraws draws of the triangle, 300 frames re-recorded every frame and 300 frames
+    // executing the bundle; prints both frame breakdowns, where "record" is the CPU cost bundles remove
+    void runBundleBenchmark() {
+        const uint32_t frameCount = 300;
+        pipelineCompiler.waitIdle();
+        drawRepeat = config.benchmarkBundleDraws;
+        if (!config.commandBundles) {
+            staticBundle.create(device, findQueueFamilies(physicalDevice).graphicsFamily.value(), &deletionQueue);
+        }
+
+        for (int bundles = 0; bundles <= 1; bundles++) {
+            config.commandBundles = bundles != 0;
+            frameStats.begin();
+            for (uint32_t i = 0; i < frameCount; i++) {
+                if (!config.headless) {
+                    glfwPollEvents();
+                }
+                drawFrame();
+            }
+            vkDeviceWaitIdle(device);
+
+            printf("%s, %u draws:\n", bundles ? "command bundle" : "re-recorded every frame", drawRepeat);
+            frameStats.print(config.framesInFlight);
+        }
+
+        const BundleStats& stats = staticBundle.getStats();
+        printf("bundles: %llu recorded, %llu reused\n", static_cast<unsigned long long>(stats.recorded), static_cast<unsigned long long>(stats.reused));
+        drawRepeat = 1;
+    }
+
+    // Cost of spawning and finishing an empty job (job system vs ThreadPool's locked queue), then a parallelFor over
+    // 16M elements on 1, 2, 4 .. core count threads. Nothing touches the GPU.
+    void runJobsBenchmark() {
+        using ms = std::chrono::duration<double, std::milli>;
+        const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+        const uint32_t spawnCount = 1000000;
+        // A full deque runs the job inline, which would time a plain call instead of a spawn: with one thread
+        // nothing drains the deque until wait(), so spawn a deque's worth at a time
+        const uint32_t batchSize = JobSystem::DEQUE_SIZE;
+
+        printf("%-34s %12s\n", "empty task, spawn to finish", "ns/task");
+        for (uint32_t threads : { 1u, cores }) {
+            JobSystem jobs;
+            jobs.start(threads);
+            JobCounter counter;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < spawnCount; i += batchSize) {
+                for (uint32_t j = i; j < std::min(i + batchSize, spawnCount); j++) {
+                    jobs.spawn([] {}, &counter);
+                }
+                jobs.wait(counter);
+            }
+            double ns = ms(std::chrono::steady_clock::now() - start).count() * 1e6 / spawnCount;
+            printf("%-34s %12.1f\n", ("job system, " + std::to_string(threads) + " threads").c_str(), ns);
+        }
+        {
+            ThreadPool pool;
+            pool.start(cores);
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < spawnCount; i += batchSize) {
+                for (uint32_t j = i; j < std::min(i + batchSize, spawnCount); j++) {
+                    pool.submit([] {});
+                }
+                pool.waitIdle();
+            }
+            double ns = ms(std::chrono::steady_clock::now() - start).count() * 1e6 / spawnCount;
+            pool.stop();
+            printf("%-34s %12.1f\n", ("ThreadPool, " + std::to_string(cores) + " threads").c_str(), ns);
+        }
+
+        const uint32_t elements = 16 * 1024 * 1024;
+        std::vector<float> data(elements);
+        for (uint32_t i = 0; i < elements; i++) {
+            data[i] = static_cast<float>(i % 1000) * 0.001f;
+        }
+
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t t = 1; t < cores; t *= 2) {
+            threadCounts.push_back(t);
+        }
+        threadCounts.push_back(cores);
+
+        printf("parallelFor over %u elements, grain 16K:\n", elements);
+        printf("%-10s %12s %10s\n", "threads", "ms", "speedup");
+        double singleMs = 0.0;
+        for (uint32_t threads : threadCounts) {
+            JobSystem jobs;
+            jobs.start(threads);
+            auto start = std::chrono::steady_clock::now();
+            for (int pass = 0; pass < 10; pass++) {
+                jobs.parallelFor(0, elements, 16 * 1024, [&](uint32_t first, uint32_t last) {
+                    for (uint32_t i = first; i < last; i++) {
+                        data[i] = std::sqrt(data[i] * data[i] + 1.0f) - 0.999f;
+                    }
+                });
+            }
+            double passMs = ms(std::chrono::steady_clock::now() - start).count() / 10;
+            if (threads == 1) {
+                singleMs = passMs;
+            }
+            printf("%-10u %12.3f %9.2fx\n", threads, passMs, singleMs / passMs);
+        }
+    }
+
+    // What the staging ring replaces: its own buffer and vkAllocateMemory, map, one submit and a wait per upload
+    void naiveUpload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size, VkFence fence) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkBuffer stagingBuffer;
+        if (vkCreateBuffer(device, &bufferInfo, hostCallbacks(), &stagingBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
+        }
+        VkMemoryRequirements memReqs;
+        vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
+        Allocation stagingMemory = allocator.allocate(memReqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            ResourceKind::Linear, true);
+        vkBindBufferMemory(device, stagingBuffer, stagingMemory.memory, 0);
+        memcpy(stagingMemory.mapped, data, static_cast<size_t>(size));
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        VkBufferCopy region{ 0, dstOffset, size };
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, dst, 1, &region);
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload!");
+        }
+        vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(device, 1, &fence);
+
+        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        allocator.destroyBuffer(stagingBuffer, stagingMemory);
+    }
+
+    void mainLoop() {
+        frameStats.begin();
+        HostAllocator::get().beginFrames();
+        framePacer.reset();
+
+        while (config.headless || !glfwWindowShouldClose(window)) {
+            // GPU first, then the frame cap, then input: whatever the frame waits for, it waits before reading input
+            waitForFrameSlot();
+            framePacer.waitForFrameStart();
+            if (!config.headless) {
+                PROFILE_SCOPE("poll events");
+                drawFromRefresh = true;
+                glfwPollEvents();
+                drawFromRefresh = false;
+            }
+            framePacer.poll();
+            if (useShaderSources()) {
+                reloadChangedShaders();
+            }
+            drawFrame();
+
+            if (config.benchmarkFrames > 0 && frameStats.frameCount() >= config.benchmarkFrames) {
+                break;
+            }
+        }
 
         vkDeviceWaitIdle(device);
+
+        if (config.benchmarkFrames > 0) {
+            frameStats.print(config.framesInFlight);
+            pipelineRegistry.printStats();
+            staging.printStats();
+            HostAllocator::get().printStats();
+            framePacer.printStats();
+            if (config.profiler) {
+                Profiler::get().printGpuStats();
+            }
+        }
     }
 
     void cleanup() {
 
-        vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
-        vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-        vkDestroyFence(device, inFlightFence, nullptr);
-
-        vkDestroyCommandPool(device, commandPool, nullptr);
+        for (FrameResources& frame : frames) {
+            vkDestroySemaphore(device, frame.imageAvailableSemaphore, hostCallbacks());
+            vkDestroySemaphore(device, frame.renderFinishedSemaphore, hostCallbacks());
+            vkDestroyFence(device, frame.inFlightFence, hostCallbacks());
+        }
 
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        recorder.destroy();
+        vkDestroyCommandPool(device, commandPool, hostCallbacks());
+
+        deletionQueue.destroy();
+        staticBundle.destroy();
+        geometry.destroy();
+        defragmenter.destroy();
+        staging.destroy();
+        frameArena.destroy();
+
+        Profiler::get().destroyGpu();
+        pipelineCompiler.destroy();
+        pipelineRegistry.destroy();
+        descriptorLayouts.destroy();
+        shaderModules.destroy();
+        shaderCompiler.destroy();
+        pipelineCache.save();
+        pipelineCache.destroy();
 
         for (auto framebuffer : swapChainFramebuffers) {
-            vkDestroyFramebuffer(device, framebuffer, nullptr);
+            vkDestroyFramebuffer(device, framebuffer, hostCallbacks());
         }
 
-        vkDestroyRenderPass(device, renderPass, nullptr);
+        vkDestroyRenderPass(device, renderPass, hostCallbacks());
 
-        for (auto imageView : swapChainImageViews) {
-            vkDestroyImageView(device, imageView, nullptr);
+        if (config.headless) {
+            offscreenTarget.destroy();
         }
+        else {
+            for (auto imageView : swapChainImageViews) {
+                vkDestroyImageView(device, imageView, hostCallbacks());
+            }
 
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
-        vkDestroyDevice(device, nullptr);
+            vkDestroySwapchainKHR(device, swapChain, hostCallbacks());
+        }
+        allocator.destroy();
+        vkDestroyDevice(device, hostCallbacks());
 
         if (enableValidationLayers) {
-            DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+            DestroyDebugUtilsMessengerEXT(instance, debugMessenger, hostCallbacks());
         }
 
-        vkDestroySurfaceKHR(instance, surface, nullptr);
-        vkDestroyInstance(instance, nullptr);
+        if (!config.headless) {
+            vkDestroySurfaceKHR(instance, surface, hostCallbacks());
+        }
+        vkDestroyInstance(instance, hostCallbacks());
 
-        glfwDestroyWindow(window);
+        if (!config.headless) {
+            glfwDestroyWindow(window);
 
-        glfwTerminate();
+            glfwTerminate();
+        }
     }
 
     void drawFrame() 
     {
-        vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
+        PROFILE_SCOPE("drawFrame");
+        FrameResources& frame = frames[currentFrame];
+        waitForFrameSlot();
+
+        // Acquired before anything else, so a stale swapchain can be replaced without using up a frame
+        uint32_t imageIndex = currentFrame;
+        if (!config.headless) {
+            PROFILE_SCOPE("acquire");
+            auto acquireStart = FrameStats::Clock::now();
+            VkResult result = vkd().vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+            frameStats.addAcquireWait(FrameStats::Clock::now() - acquireStart);
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                // Nothing acquired or submitted: the fence stays signalled for the next try
+                recreateSwapChain();
+                return;
+            }
+            if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
+        }
 
-        vkResetFences(device, 1, &inFlightFence);
+        // Swap in rebuilt pipelines and free the ones (and moved-out resources) no frame in flight can still use
+        pipelineRegistry.update(frameNumber, config.framesInFlight);
+        defragmenter.update(frameNumber, config.framesInFlight);
+        staging.update(frameNumber, config.framesInFlight);
+        deletionQueue.update(frameNumber, config.framesInFlight);
+        frameArena.beginFrame(currentFrame);
+        if (config.recordThreads > 0) {
+            recorder.beginFrame(currentFrame);
+        }
+        frameNumber++;
 
-        uint32_t imageIndex;
-        vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+        vkd().vkResetFences(device, 1, &frame.inFlightFence);
+
+        // With a transfer queue this frame's uploads start now, next to whatever the graphics queue is still rendering
+        VkSemaphore uploadsDone = staging.submit();
+
+        if (config.headless) {
+            drawFrameHeadless(frame, uploadsDone);
+            return;
+        }
 
-        vkResetCommandBuffer(commandBuffer, 0);
+        auto recordStart = FrameStats::Clock::now();
+        vkd().vkResetCommandBuffer(frame.commandBuffer, 0);
 
-        recordCommandBuffer(commandBuffer, imageIndex);
+        recordCommandBuffer(frame.commandBuffer, imageIndex);
+        frameStats.addRecord(FrameStats::Clock::now() - recordStart);
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
         // next two are parallel indices
-        VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
+        VkSemaphore waitSemaphores[] = { frame.imageAvailableSemaphore, uploadsDone };
+        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+        submitInfo.waitSemaphoreCount = uploadsDone != VK_NULL_HANDLE ? 2 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-        VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
+        submitInfo.pCommandBuffers = &frame.commandBuffer;
+        VkSemaphore signalSemaphores[] = { frame.renderFinishedSemaphore };
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence) != VK_SUCCESS) {
+        auto submitStart = FrameStats::Clock::now();
+        if (vkd().vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.inFlightFence) != VK_SUCCESS) {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
+        frameStats.addSubmit(FrameStats::Clock::now() - submitStart);
+        framePacer.markSubmitted(currentFrame, frame.inFlightFence);
+
+        pipelineCache.checkpoint(frameStats.frameCount(), config.pipelineCacheCheckpointFrames);
 
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -310,7 +1584,117 @@ private:
         presentInfo.pImageIndices = &imageIndex;
     
         presentInfo.pResults = nullptr; // Optional
-        vkQueuePresentKHR(presentQueue, &presentInfo);
+
+        uint64_t presentId = ++presentCount;
+        VkPresentIdKHR presentIdInfo{};
+        if (presentWaitEnabled) {
+            presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+            presentIdInfo.swapchainCount = 1;
+            presentIdInfo.pPresentIds = &presentId;
+            presentInfo.pNext = &presentIdInfo;
+        }
+
+        auto presentStart = FrameStats::Clock::now();
+        VkResult result = vkd().vkQueuePresentKHR(presentQueue, &presentInfo);
+        frameStats.addSubmit(FrameStats::Clock::now() - presentStart);
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            framePacer.markPresented(swapChain, presentId);
+        }
+        // FIFO presents can block for a vblank, during which earlier frames finish
+        framePacer.poll();
+
+        frameStats.endFrame();
+        HostAllocator::get().endFrame();
+        currentFrame = (currentFrame + 1) % config.framesInFlight;
+
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+            recreateSwapChain();
+        }
+        else if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
+    }
+
+    // Only blocks when the GPU is still busy with the frame that last used the current slot
+    void waitForFrameSlot() {
+        PROFILE_SCOPE("wait for frame slot");
+        FrameResources& frame = frames[currentFrame];
+        framePacer.poll();
+        auto waitStart = FrameStats::Clock::now();
+        vkd().vkWaitForFences(device, 1, &frame.inFlightFence, VK_TRUE, UINT64_MAX);
+        frameStats.addFenceWait(FrameStats::Clock::now() - waitStart);
+        framePacer.markCompleted(currentFrame);
+    }
+
+    // The new swapchain is built from the old one, which goes to the deletion queue with its image views and
+    // framebuffers: frames still in flight finish on them, and nothing waits for the device.
+    void recreateSwapChain() {
+        PROFILE_SCOPE("recreateSwapChain");
+        // Minimized: nothing to present to until the window comes back
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        while ((width == 0 || height == 0) && !glfwWindowShouldClose(window)) {
+            glfwWaitEvents();
+            glfwGetFramebufferSize(window, &width, &height);
+        }
+        if (width == 0 || height == 0) {
+            return;
+        }
+
+        auto start = FrameStats::Clock::now();
+        for (VkFramebuffer framebuffer : swapChainFramebuffers) {
+            deletionQueue.destroyFramebuffer(framebuffer);
+        }
+        for (VkImageView imageView : swapChainImageViews) {
+            deletionQueue.destroyImageView(imageView);
+        }
+        // Bundles of targets not drawn since hold the old framebuffers, whose handle values can come back
+        staticBundle.invalidate();
+        VkSwapchainKHR oldSwapChain = swapChain;
+        createSwapChain(oldSwapChain);
+        deletionQueue.destroySwapchain(oldSwapChain);
+        framePacer.swapchainChanged();
+
+        createImageViews();
+        createFramebuffers();
+        framebufferResized = false;
+        frameStats.addSwapchainRecreate(FrameStats::Clock::now() - start);
+    }
+
+    // One offscreen image per frame slot, so the slot's fence also guards its image: no acquire, no present
+    void drawFrameHeadless(FrameResources& frame, VkSemaphore uploadsDone)
+    {
+        uint32_t imageIndex = currentFrame;
+
+        auto recordStart = FrameStats::Clock::now();
+        vkd().vkResetCommandBuffer(frame.commandBuffer, 0);
+
+        recordCommandBuffer(frame.commandBuffer, imageIndex);
+        frameStats.addRecord(FrameStats::Clock::now() - recordStart);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        if (uploadsDone != VK_NULL_HANDLE) {
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &uploadsDone;
+            submitInfo.pWaitDstStageMask = &waitStage;
+        }
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &frame.commandBuffer;
+
+        auto submitStart = FrameStats::Clock::now();
+        if (vkd().vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.inFlightFence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+        frameStats.addSubmit(FrameStats::Clock::now() - submitStart);
+        framePacer.markSubmitted(currentFrame, frame.inFlightFence);
+
+        pipelineCache.checkpoint(frameStats.frameCount(), config.pipelineCacheCheckpointFrames);
+
+        frameStats.endFrame();
+        HostAllocator::get().endFrame();
+        currentFrame = (currentFrame + 1) % config.framesInFlight;
     }
 
 
@@ -331,7 +1715,7 @@ private:
             framebufferInfo.height = swapChainExtent.height;
             framebufferInfo.layers = 1;
 
-            if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
+            if (vkCreateFramebuffer(device, &framebufferInfo, hostCallbacks(), &swapChainFramebuffers[i]) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create framebuffer!");
             }
         }
@@ -348,7 +1732,8 @@ private:
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // 1.1 for vkGetPhysicalDeviceFeatures2, to ask about present wait
+        appInfo.apiVersion = VK_API_VERSION_1_1;
 
         VkInstanceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -372,7 +1757,7 @@ private:
             createInfo.pNext = nullptr;
         }
 
-        if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+        if (vkCreateInstance(&createInfo, hostCallbacks(), &instance) != VK_SUCCESS) {
             throw std::runtime_error("failed to create instance!");
         }
     }
@@ -391,13 +1776,21 @@ private:
         VkDebugUtilsMessengerCreateInfoEXT createInfo;
         populateDebugMessengerCreateInfo(createInfo);
 
-        if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+        if (CreateDebugUtilsMessengerEXT(instance, &createInfo, hostCallbacks(), &debugMessenger) != VK_SUCCESS) {
             throw std::runtime_error("failed to set up debug messenger!");
         }
     }
 
+    void createOffscreenTarget() {
+        offscreenTarget.create(&allocator, { WIDTH, HEIGHT }, VK_FORMAT_R8G8B8A8_UNORM, config.framesInFlight);
+
+        swapChainImageFormat = offscreenTarget.getFormat();
+        swapChainExtent = offscreenTarget.getExtent();
+        swapChainImageViews = offscreenTarget.getImageViews();
+    }
+
     void createSurface() {
-        if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
+        if (glfwCreateWindowSurface(instance, window, hostCallbacks(), &surface) != VK_SUCCESS) {
             throw std::runtime_error("failed to create window surface!");
         }
     }
@@ -429,7 +1822,16 @@ private:
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+        std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value() };
+        if (indices.presentFamily.has_value()) {
+            uniqueQueueFamilies.insert(indices.presentFamily.value());
+        }
+        if (indices.transferFamily.has_value()) {
+            uniqueQueueFamilies.insert(indices.transferFamily.value());
+        }
+        if (indices.computeFamily.has_value()) {
+            uniqueQueueFamilies.insert(indices.computeFamily.value());
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -446,13 +1848,27 @@ private:
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
+        std::vector<const char*> extensions = getDeviceExtensions();
+        presentWaitEnabled = checkPresentWaitSupport(physicalDevice);
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitFeatures.presentWait = VK_TRUE;
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        presentIdFeatures.presentId = VK_TRUE;
+        if (presentWaitEnabled) {
+            extensions.insert(extensions.end(), presentWaitExtensions.begin(), presentWaitExtensions.end());
+            createInfo.pNext = &presentIdFeatures;
+        }
+
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
         createInfo.pEnabledFeatures = &deviceFeatures;
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         if (enableValidationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -462,19 +1878,27 @@ private:
             createInfo.enabledLayerCount = 0;
         }
 
-        if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+        if (vkCreateDevice(physicalDevice, &createInfo, hostCallbacks(), &device) != VK_SUCCESS) {
             throw std::runtime_error("failed to create logical device!");
         }
 
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-        vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        if (indices.presentFamily.has_value()) {
+            vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        }
+        if (indices.transferFamily.has_value()) {
+            vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+        }
+        if (indices.computeFamily.has_value()) {
+            vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+        }
     }
 
-    void createSwapChain() {
+    void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+        VkPresentModeKHR presentMode = framePacer.choosePresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
         uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -510,9 +1934,14 @@ private:
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        createInfo.oldSwapchain = oldSwapChain;
+
+        // The render pass was made for the first format; checked before creating, so no swapchain is left behind
+        if (oldSwapChain != VK_NULL_HANDLE && surfaceFormat.format != swapChainImageFormat) {
+            throw std::runtime_error("swap chain format changed!");
+        }
 
-        if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
+        if (vkCreateSwapchainKHR(device, &createInfo, hostCallbacks(), &swapChain) != VK_SUCCESS) {
             throw std::runtime_error("failed to create swap chain!");
         }
 
@@ -543,7 +1972,7 @@ private:
             createInfo.subresourceRange.baseArrayLayer = 0;
             createInfo.subresourceRange.layerCount = 1;
 
-            if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
+            if (vkCreateImageView(device, &createInfo, hostCallbacks(), &swapChainImageViews[i]) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create image views!");
             }
         }
@@ -558,7 +1987,8 @@ private:
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        // Offscreen images are left ready to be copied out instead of presented
+        colorAttachment.finalLayout = config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentRef{};
         colorAttachmentRef.attachment = 0;
@@ -587,131 +2017,111 @@ private:
         renderPassInfo.dependencyCount = 1;
         renderPassInfo.pDependencies = &dependency;
 
-        if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        if (vkCreateRenderPass(device, &renderPassInfo, hostCallbacks(), &renderPass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
     }
 
-    void createGraphicsPipeline() {
-        auto vertShaderCode = readFile("assets/shaders/bytecodes/vert_bare.spv");
-        auto fragShaderCode = readFile("assets/shaders/bytecodes/frag_bare.spv");
-
-        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertShaderStageInfo.module = vertShaderModule;
-        vertShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragShaderStageInfo.module = fragShaderModule;
-        fragShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 0;
-        vertexInputInfo.vertexAttributeDescriptionCount = 0;
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-        VkPipelineViewportStateCreateInfo viewportState{};
-        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1;
-        viewportState.scissorCount = 1;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.depthClampEnable = VK_FALSE;
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;
-        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-        rasterizer.depthBiasEnable = VK_FALSE;
-
-        VkPipelineMultisampleStateCreateInfo multisampling{};
-        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
-
-        VkPipelineColorBlendStateCreateInfo colorBlending{};
-        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.logicOpEnable = VK_FALSE;
-        colorBlending.logicOp = VK_LOGIC_OP_COPY;
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &colorBlendAttachment;
-        colorBlending.blendConstants[0] = 0.0f;
-        colorBlending.blendConstants[1] = 0.0f;
-        colorBlending.blendConstants[2] = 0.0f;
-        colorBlending.blendConstants[3] = 0.0f;
-
-        std::vector<VkDynamicState> dynamicStates = {
-            VK_DYNAMIC_STATE_VIEWPORT,
-            VK_DYNAMIC_STATE_SCISSOR
-        };
-        VkPipelineDynamicStateCreateInfo dynamicState{};
-        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-        dynamicState.pDynamicStates = dynamicStates.data();
+    bool useShaderSources() const {
+        return config.hotReload && ShaderCompiler::isAvailable();
+    }
+
+    // GLSL when the compiler is built in (cached on disk, watched for edits), else the offline .spv
+    ShaderId loadShader(const std::string& source, const std::string& bytecode) {
+        if (!useShaderSources()) {
+            return shaderLibrary.intern(bytecode);
+        }
+        ShaderId id = shaderLibrary.intern(source);
+        shaderWatcher.watch(id, source);
+        return id;
+    }
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
+    void reloadChangedShaders() {
+        PROFILE_SCOPE("reloadChangedShaders");
+        for (ShaderId id : shaderWatcher.poll()) {
+            shaderModules.invalidate(id);
+            uint32_t rebuilt = pipelineRegistry.rebuildUsing(id);
+            printf("%s changed, rebuilding %u pipeline(s)\n", shaderLibrary.getPath(id).c_str(), rebuilt);
+        }
+    }
+
+    ShaderId meshVertShader() {
+        return loadShader("assets/shaders/vertex/vert_mesh.glsl", "assets/shaders/bytecodes/vert_mesh.spv");
+    }
 
-        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create pipeline layout!");
+    ShaderId meshFragShader() {
+        return loadShader("assets/shaders/fragment/frag_bare.glsl", "assets/shaders/bytecodes/frag_bare.spv");
+    }
+
+    // Compiles and reads every shader the startup pipelines use, several at once, before there is a device.
+    // Failures are ignored here: createGraphicsPipeline() and createVariantPipelines() load the same shaders
+    // again and report them.
+    void prefetchShaders(JobSystem& jobs) {
+        std::vector<ShaderId> ids = { meshVertShader(), meshFragShader() };
+        try {
+            for (const ShaderVariant& variant : loadVariantManifest(config.variantManifest)) {
+                ids.push_back(loadShader(variant.vertSource, variant.vertBytecode));
+                ids.push_back(loadShader(variant.fragSource, variant.fragBytecode));
+            }
+        }
+        catch (const std::exception&) {
         }
 
-        VkGraphicsPipelineCreateInfo pipelineInfo{};
-        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = shaderStages;
-        pipelineInfo.pVertexInputState = &vertexInputInfo;
-        pipelineInfo.pInputAssemblyState = &inputAssembly;
-        pipelineInfo.pViewportState = &viewportState;
-        pipelineInfo.pRasterizationState = &rasterizer;
-        pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.pDynamicState = &dynamicState;
-        pipelineInfo.layout = pipelineLayout;
-        pipelineInfo.renderPass = renderPass;
-        pipelineInfo.subpass = 0;
-        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        jobs.parallelFor(0, static_cast<uint32_t>(ids.size()), 1, [&](uint32_t first, uint32_t last) {
+            for (uint32_t i = first; i < last; i++) {
+                try {
+                    shaderModules.prefetch(ids[i]);
+                }
+                catch (const std::exception&) {
+                }
+            }
+        });
+    }
 
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create graphics pipeline!");
+    void createGraphicsPipeline() {
+        PipelineDesc desc;
+        desc.vertShader = meshVertShader();
+        desc.fragShader = meshFragShader();
+        desc.renderPass = renderPass;
+        // Set layouts, push constants and vertex inputs come from the shaders themselves
+        ShaderReflection shaders = mergeReflection(shaderModules.reflect(desc.vertShader), shaderModules.reflect(desc.fragShader));
+        desc.layout = descriptorLayouts.describe(shaders);
+        desc.vertexLayout = VertexLayoutDesc::packed(shaders);
+        if (desc.vertexLayout.stride != sizeof(MeshVertex)) {
+            throw std::runtime_error("vert_mesh inputs don't match MeshVertex!");
         }
 
-        vkDestroyShaderModule(device, fragShaderModule, nullptr);
-        vkDestroyShaderModule(device, vertShaderModule, nullptr);
+        // Compiles on a worker; frames just clear until it is ready
+        trianglePipeline = pipelineRegistry.request(desc);
     }
 
-    VkShaderModule createShaderModule(const std::vector<char>& code) {
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    // Every variant in the manifest is queued now, so switching to one later never compiles
+    void createVariantPipelines() {
+        for (const ShaderVariant& variant : loadVariantManifest(config.variantManifest)) {
+            try {
+                PipelineDesc desc;
+                desc.vertShader = loadShader(variant.vertSource, variant.vertBytecode);
+                desc.fragShader = loadShader(variant.fragSource, variant.fragBytecode);
+                desc.renderPass = renderPass;
+
+                ShaderReflection shaders = mergeReflection(shaderModules.reflect(desc.vertShader), shaderModules.reflect(desc.fragShader));
+                desc.layout = descriptorLayouts.describe(shaders);
+                desc.specialization = specializeVariant(variant, shaders);
 
-        VkShaderModule shaderModule;
-        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create shader module!");
+                variantPipelines[variant.name] = pipelineRegistry.request(desc);
+            }
+            catch (const std::exception& e) {
+                printf("skipping shader variant %s: %s\n", variant.name.c_str(), e.what());
+            }
         }
 
-        return shaderModule;
+        if (!config.variant.empty()) {
+            auto it = variantPipelines.find(config.variant);
+            if (it == variantPipelines.end()) {
+                throw std::runtime_error("unknown shader variant: " + config.variant);
+            }
+            trianglePipeline = it->second;
+        }
     }
 
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -724,16 +2134,6 @@ private:
         return availableFormats[0];
     }
 
-    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-        for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                return availablePresentMode;
-            }
-        }
-
-        return VK_PRESENT_MODE_FIFO_KHR;
-    }
-
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
         if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
             return capabilities.currentExtent;
@@ -783,6 +2183,10 @@ private:
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
+        if (config.headless) {
+            return indices.isComplete(false) && extensionsSupported;
+        }
+
         bool swapChainAdequate = false;
         if (extensionsSupported) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
@@ -793,13 +2197,17 @@ private:
     }
 
     bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
+        return hasDeviceExtensions(device, getDeviceExtensions());
+    }
+
+    bool hasDeviceExtensions(VkPhysicalDevice device, const std::vector<const char*>& extensions) {
         uint32_t extensionCount;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
         for (const auto& extension : availableExtensions) {
             requiredExtensions.erase(extension.extensionName);
@@ -808,6 +2216,29 @@ private:
         return requiredExtensions.empty();
     }
 
+    // Both extensions and both features; vkGetPhysicalDeviceFeatures2 needs a 1.1 device
+    bool checkPresentWaitSupport(VkPhysicalDevice device) {
+        if (config.headless || !hasDeviceExtensions(device, presentWaitExtensions)) {
+            return false;
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_1) {
+            return false;
+        }
+
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWait{};
+        presentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        VkPhysicalDevicePresentIdFeaturesKHR presentId{};
+        presentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentId.pNext = &presentWait;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &presentId;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+        return presentId.presentId && presentWait.presentWait;
+    }
+
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
         QueueFamilyIndices indices;
 
@@ -823,29 +2254,59 @@ private:
                 indices.graphicsFamily = i;
             }
 
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (!config.headless) {
+                VkBool32 presentSupport = false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
 
-            if (presentSupport) {
-                indices.presentFamily = i;
+                if (presentSupport) {
+                    indices.presentFamily = i;
+                }
             }
 
-            if (indices.isComplete()) {
+            if (indices.isComplete(!config.headless)) {
                 break;
             }
 
             i++;
         }
 
+        // Prefer a transfer-only family (the DMA engines), else any non-graphics one that can copy;
+        // async compute wants compute without graphics
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if (flags & VK_QUEUE_GRAPHICS_BIT) {
+                continue;
+            }
+            bool transferOnly = !(flags & VK_QUEUE_COMPUTE_BIT);
+            if ((flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) && (transferOnly || !indices.transferFamily.has_value())) {
+                indices.transferFamily = family;
+            }
+            if ((flags & VK_QUEUE_COMPUTE_BIT) && !indices.computeFamily.has_value()) {
+                indices.computeFamily = family;
+            }
+        }
+
         return indices;
     }
 
+    std::vector<const char*> getDeviceExtensions() {
+        if (config.headless) {
+            return {};
+        }
+
+        return deviceExtensions;
+    }
+
     std::vector<const char*> getRequiredExtensions() {
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        std::vector<const char*> extensions;
 
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        if (!config.headless) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -879,24 +2340,6 @@ private:
         return true;
     }
 
-    static std::vector<char> readFile(const std::string& filename) {
-        std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-        if (!file.is_open()) {
-            throw std::runtime_error("failed to open file!");
-        }
-
-        size_t fileSize = (size_t)file.tellg();
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-
-        file.close();
-
-        return buffer;
-    }
-
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
         std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
 
@@ -904,10 +2347,9 @@ private:
     }
 };
 
-int main() {
-    HelloTriangleApplication app;
-
+int main(int argc, char** argv) {
     try {
+        HelloTriangleApplication app(parseAppConfig(argc, argv));
         app.run();
     }
     catch (const std::exception& e) {
@@ -0,0 +1,24 @@
+#version 450
+
+// Specialization constants, set per pipeline from assets/shaders/variants.txt.
+// Branches on them are resolved when the pipeline is compiled.
+layout(constant_id = 0) const bool GRAYSCALE = false;
+layout(constant_id = 1) const int POSTERIZE_LEVELS = 0;
+layout(constant_id = 2) const float BRIGHTNESS = 1.0;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 0) in vec3 fragColor;
+
+void main() {
+    vec3 color = fragColor * BRIGHTNESS;
+
+    if (GRAYSCALE) {
+        color = vec3(dot(color, vec3(0.299, 0.587, 0.114)));
+    }
+
+    if (POSTERIZE_LEVELS > 0) {
+        color = floor(color * float(POSTERIZE_LEVELS)) / float(POSTERIZE_LEVELS);
+    }
+
+    outColor = vec4(color, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 450
+
+// Per-vertex attributes from the geometry buffer (MeshVertex)
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// Outputs to fragment shader
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
+}
\ No newline at end of file
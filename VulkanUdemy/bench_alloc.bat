@@ -0,0 +1,10 @@
+cd /d "%~dp0"
+
+rem Allocate/free churn: the device sub-allocator vs one vkAllocateMemory per resource.
+rem An optional argument sets how many allocations stay alive (default 2000).
+if "%~1"=="" (
+    ..\x64\Release\VulkanUdemy.exe --headless --bench-alloc
+) else (
+    ..\x64\Release\VulkanUdemy.exe --headless --bench-alloc --bench-alloc-live %1
+)
+pause
@@ -0,0 +1,6 @@
+cd /d "%~dp0"
+
+rem A static scene of 20K draws: 300 frames re-recorded every frame, then 300 frames re-executing one bundle per
+rem framebuffer. Compare the "record" line of the two frame breakdowns.
+..\x64\Release\VulkanUdemy.exe --bench-bundles 20000
+pause
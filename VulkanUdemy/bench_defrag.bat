@@ -0,0 +1,10 @@
+cd /d "%~dp0"
+
+rem Fragments device memory on purpose, then reports how many frames, bytes and ms the defragmenter needs to compact it.
+rem An optional argument sets the per-frame copy budget in KB (default 4096).
+if "%~1"=="" (
+    ..\x64\Release\VulkanUdemy.exe --headless --bench-defrag
+) else (
+    ..\x64\Release\VulkanUdemy.exe --headless --bench-defrag --defrag-budget %1
+)
+pause
@@ -0,0 +1,6 @@
+cd /d "%~dp0"
+
+rem Records 100K draws into one command buffer through the loader's exports and through the device dispatch
+rem table and prints the cost per call. Build Release: validation layers sit behind both and hide the difference.
+..\x64\Release\VulkanUdemy.exe --bench-dispatch 100000 --headless
+pause
@@ -0,0 +1,10 @@
+cd /d "%~dp0"
+
+rem Writes per-object constants for N objects a frame (default 10000): frame arena on every core and on one thread
+rem vs a new uniform buffer per object. CPU only.
+if "%~1"=="" (
+    ..\x64\Release\VulkanUdemy.exe --headless --bench-frame-alloc 10000
+) else (
+    ..\x64\Release\VulkanUdemy.exe --headless --bench-frame-alloc %1
+)
+pause
@@ -0,0 +1,9 @@
+cd /d "%~dp0"
+
+rem Frames/sec and CPU-blocked time for 1, 2 and 3 frames in flight.
+rem Pass a software driver manifest (SwiftShader/lavapipe ICD json) as the first argument to bench on it,
+rem and --headless as the second to take the window system and vsync out of the measurement.
+if not "%~1"=="" set VK_ICD_FILENAMES=%~1
+
+for %%n in (1 2 3) do ..\x64\Release\VulkanUdemy.exe --frames-in-flight %%n --bench-frames 2000 %2
+pause
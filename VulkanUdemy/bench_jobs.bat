@@ -0,0 +1,6 @@
+cd /d "%~dp0"
+
+rem Job system microbenchmarks: cost of an empty task from spawn to finish (job system vs ThreadPool), and
+rem parallelFor over 16M elements on 1, 2, 4 .. core count threads.
+..\x64\Release\VulkanUdemy.exe --bench-jobs --headless
+pause
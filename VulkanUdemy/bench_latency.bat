@@ -0,0 +1,10 @@
+cd /d "%~dp0"
+
+rem Renders 1000 frames under each present policy and prints input -> submit and submit -> present
+rem latency percentiles (submit -> GPU done on devices without VK_KHR_present_wait). Add --fps-limit N to see
+rem the limiter move the wait in front of input sampling.
+..\x64\Release\VulkanUdemy.exe --bench-frames 1000 --present low-latency
+..\x64\Release\VulkanUdemy.exe --bench-frames 1000 --present immediate
+..\x64\Release\VulkanUdemy.exe --bench-frames 1000 --present relaxed
+..\x64\Release\VulkanUdemy.exe --bench-frames 1000 --present power-saving
+pause
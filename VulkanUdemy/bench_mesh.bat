@@ -0,0 +1,13 @@
+cd /d "%~dp0"
+
+rem Indexed-draw throughput (triangles/sec) for grids of 1K to 10M triangles, rendered offscreen.
+rem Pass a software driver manifest (SwiftShader/lavapipe ICD json) as the first argument to bench on it;
+rem a second argument caps the largest grid (e.g. 1000000 on small GPUs or software drivers).
+if not "%~1"=="" set VK_ICD_FILENAMES=%~1
+
+if "%~2"=="" (
+    ..\x64\Release\VulkanUdemy.exe --headless --bench-mesh
+) else (
+    ..\x64\Release\VulkanUdemy.exe --headless --bench-mesh --bench-mesh-max %2
+)
+pause
\ No newline at end of file
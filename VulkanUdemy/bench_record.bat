@@ -0,0 +1,6 @@
+cd /d "%~dp0"
+
+rem Records 100K draws a frame into secondary command buffers on 1, 2, 4 .. core count threads and prints
+rem draws/sec and the speedup over one thread. Recording only: nothing is submitted.
+..\x64\Release\VulkanUdemy.exe --bench-record 100000 --headless
+pause
@@ -0,0 +1,6 @@
+cd /d "%~dp0"
+
+rem Replaces the drawn geometry every 4th frame, retiring the old buffers through the deletion queue,
+rem then with a vkDeviceWaitIdle per replacement, and prints frame times for both.
+..\x64\Release\VulkanUdemy.exe --headless --bench-replace
+pause
@@ -0,0 +1,6 @@
+cd /d "%~dp0"
+
+rem Resizes the window every frame for 300 frames and prints frame times, the worst frame and the cost of
+rem each swapchain recreation. For a real border drag, run with --bench-frames N and drag the window.
+..\x64\Release\VulkanUdemy.exe --bench-resize
+pause
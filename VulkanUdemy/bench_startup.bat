@@ -0,0 +1,11 @@
+cd /d "%~dp0"
+
+rem Startup time with a cold pipeline cache, then with the warm cache the first run left behind, then warm again
+rem with every startup stage on one thread to show what the overlap saves.
+if not "%~1"=="" set VK_ICD_FILENAMES=%~1
+
+del /q bench_pipeline_cache.bin 2>nul
+..\x64\Release\VulkanUdemy.exe --bench-startup --pipeline-cache bench_pipeline_cache.bin %2
+..\x64\Release\VulkanUdemy.exe --bench-startup --pipeline-cache bench_pipeline_cache.bin %2
+..\x64\Release\VulkanUdemy.exe --bench-startup --startup-threads 1 --pipeline-cache bench_pipeline_cache.bin %2
+pause
@@ -0,0 +1,10 @@
+cd /d "%~dp0"
+
+rem Streams N MB per frame (default 8) while drawing a 1M triangle grid, first on the dedicated transfer queue,
+rem then on the graphics queue. The difference in frame time is the copying that overlapped rendering.
+set MB=8
+if not "%~1"=="" set MB=%~1
+
+..\x64\Release\VulkanUdemy.exe --headless --bench-stream %MB%
+..\x64\Release\VulkanUdemy.exe --headless --bench-stream %MB% --no-transfer-queue
+pause
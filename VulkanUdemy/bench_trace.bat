@@ -0,0 +1,6 @@
+cd /d "%~dp0"
+
+rem Renders 300 frames and writes trace.json with CPU scopes from every thread and GPU timestamps on one
+rem timeline; open it in chrome://tracing or ui.perfetto.dev. Also prints average GPU time per scope.
+..\x64\Release\VulkanUdemy.exe --bench-frames 300 --trace trace.json
+pause
@@ -0,0 +1,10 @@
+cd /d "%~dp0"
+
+rem Upload throughput (MB/s) from 64 B to 64 MB: the staging ring vs a staging buffer + submit + wait per upload.
+rem An optional argument sets the ring size in MB (default 32).
+if "%~1"=="" (
+    ..\x64\Release\VulkanUdemy.exe --headless --bench-upload
+) else (
+    ..\x64\Release\VulkanUdemy.exe --headless --bench-upload --staging-ring %1
+)
+pause
@@ -1,5 +1,8 @@
 cd /d "%~dp0"
 
-C:/VulkanSDK/1.3.268.0/Bin/glslc.exe -fshader-stage=vert C:/Users/jlhar/OneDrive/Desktop/VS_PJX/VS2022/VulkanUdemy/VulkanUdemy/assets/shaders/vertex/vert_bare.glsl -o assets/shaders/bytecodes/vert_bare.spv
-C:/VulkanSDK/1.3.268.0/Bin/glslc.exe -fshader-stage=frag C:/Users/jlhar/OneDrive/Desktop/VS_PJX/VS2022/VulkanUdemy/VulkanUdemy/assets/shaders/fragment/frag_bare.glsl -o assets/shaders/bytecodes/frag_bare.spv
+rem Offline fallback for builds without USE_SHADERC; the app compiles these itself otherwise
+"%VULKAN_SDK%/Bin/glslc.exe" -fshader-stage=vert assets/shaders/vertex/vert_bare.glsl -o assets/shaders/bytecodes/vert_bare.spv
+"%VULKAN_SDK%/Bin/glslc.exe" -fshader-stage=vert assets/shaders/vertex/vert_mesh.glsl -o assets/shaders/bytecodes/vert_mesh.spv
+"%VULKAN_SDK%/Bin/glslc.exe" -fshader-stage=frag assets/shaders/fragment/frag_bare.glsl -o assets/shaders/bytecodes/frag_bare.spv
+"%VULKAN_SDK%/Bin/glslc.exe" -fshader-stage=frag assets/shaders/fragment/frag_variant.glsl -o assets/shaders/bytecodes/frag_variant.spv
 pause
\ No newline at end of file
@@ -0,0 +1,282 @@
+#include "AppConfig.h"
+
+#include <stdexcept>
+#include <cstdlib>
+#include <thread>
+
+static uint32_t parseCount(const std::string& option, const char* value)
+{
+	if (value == nullptr)
+	{
+		throw std::runtime_error("missing value for " + option);
+	}
+
+	char* end = nullptr;
+	unsigned long parsed = std::strtoul(value, &end, 10);
+	if (end == value || *end != '\0')
+	{
+		throw std::runtime_error("invalid value for " + option + ": " + value);
+	}
+
+	return static_cast<uint32_t>(parsed);
+}
+
+AppConfig parseAppConfig(int argc, char** argv)
+{
+	AppConfig config;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if (arg == "--frames-in-flight")
+		{
+			config.framesInFlight = parseCount(arg, value);
+			if (config.framesInFlight == 0)
+			{
+				throw std::runtime_error("--frames-in-flight must be at least 1");
+			}
+			i++;
+		}
+		else if (arg == "--bench-frames")
+		{
+			config.benchmarkFrames = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--headless")
+		{
+			config.headless = true;
+		}
+		else if (arg == "--bench-startup")
+		{
+			config.benchmarkStartup = true;
+		}
+		else if (arg == "--bench-mesh")
+		{
+			config.benchmarkMesh = true;
+		}
+		else if (arg == "--bench-mesh-max")
+		{
+			config.meshBenchmarkMaxTriangles = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--bench-alloc")
+		{
+			config.benchmarkAllocator = true;
+		}
+		else if (arg == "--bench-alloc-live")
+		{
+			config.allocatorBenchmarkLive = parseCount(arg, value);
+			if (config.allocatorBenchmarkLive == 0)
+			{
+				throw std::runtime_error("--bench-alloc-live must be at least 1");
+			}
+			i++;
+		}
+		else if (arg == "--bench-defrag")
+		{
+			config.benchmarkDefrag = true;
+		}
+		else if (arg == "--defrag-budget")
+		{
+			config.defragBudgetKB = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--bench-upload")
+		{
+			config.benchmarkUpload = true;
+		}
+		else if (arg == "--staging-ring")
+		{
+			config.stagingRingMB = parseCount(arg, value);
+			if (config.stagingRingMB == 0)
+			{
+				throw std::runtime_error("--staging-ring must be at least 1");
+			}
+			i++;
+		}
+		else if (arg == "--no-transfer-queue")
+		{
+			config.transferQueue = false;
+		}
+		else if (arg == "--bench-stream")
+		{
+			config.benchmarkStreamMB = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--frame-arena")
+		{
+			config.frameArenaKB = parseCount(arg, value);
+			if (config.frameArenaKB == 0)
+			{
+				throw std::runtime_error("--frame-arena must be at least 1");
+			}
+			i++;
+		}
+		else if (arg == "--bench-frame-alloc")
+		{
+			config.benchmarkFrameAllocObjects = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--bench-replace")
+		{
+			config.benchmarkReplace = true;
+		}
+		else if (arg == "--bench-resize")
+		{
+			config.benchmarkResize = true;
+		}
+		else if (arg == "--startup-threads")
+		{
+			config.startupThreads = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--record-threads")
+		{
+			config.recordThreads = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--bench-record")
+		{
+			config.benchmarkRecordDraws = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--bench-jobs")
+		{
+			config.benchmarkJobs = true;
+		}
+		else if (arg == "--no-dispatch-tables")
+		{
+			config.dispatchTables = false;
+		}
+		else if (arg == "--bench-dispatch")
+		{
+			config.benchmarkDispatchDraws = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--no-bundles")
+		{
+			config.commandBundles = false;
+		}
+		else if (arg == "--bench-bundles")
+		{
+			config.benchmarkBundleDraws = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--present")
+		{
+			if (value == nullptr)
+			{
+				throw std::runtime_error("missing value for " + arg);
+			}
+			std::string policy = value;
+			if (policy == "low-latency")
+			{
+				config.presentPolicy = PresentPolicy::LowLatency;
+			}
+			else if (policy == "immediate")
+			{
+				config.presentPolicy = PresentPolicy::Immediate;
+			}
+			else if (policy == "power-saving")
+			{
+				config.presentPolicy = PresentPolicy::PowerSaving;
+			}
+			else if (policy == "relaxed")
+			{
+				config.presentPolicy = PresentPolicy::Relaxed;
+			}
+			else
+			{
+				throw std::runtime_error("invalid value for " + arg + ": " + policy + " (low-latency, immediate, power-saving or relaxed)");
+			}
+			i++;
+		}
+		else if (arg == "--fps-limit")
+		{
+			config.fpsLimit = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--no-host-allocator")
+		{
+			config.hostAllocator = false;
+		}
+		else if (arg == "--no-profiler")
+		{
+			config.profiler = false;
+		}
+		else if (arg == "--trace")
+		{
+			if (value == nullptr)
+			{
+				throw std::runtime_error("missing value for " + arg);
+			}
+			config.traceFile = value;
+			i++;
+		}
+		else if (arg == "--pipeline-cache")
+		{
+			if (value == nullptr)
+			{
+				throw std::runtime_error("missing value for " + arg);
+			}
+			config.pipelineCachePath = value;
+			i++;
+		}
+		else if (arg == "--no-pipeline-cache")
+		{
+			config.pipelineCachePath.clear();
+		}
+		else if (arg == "--pipeline-cache-checkpoint")
+		{
+			config.pipelineCacheCheckpointFrames = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--pipeline-threads")
+		{
+			config.pipelineThreads = parseCount(arg, value);
+			i++;
+		}
+		else if (arg == "--shader-cache")
+		{
+			if (value == nullptr)
+			{
+				throw std::runtime_error("missing value for " + arg);
+			}
+			config.shaderCacheDir = value;
+			i++;
+		}
+		else if (arg == "--no-hot-reload")
+		{
+			config.hotReload = false;
+		}
+		else if (arg == "--variants" || arg == "--variant")
+		{
+			if (value == nullptr)
+			{
+				throw std::runtime_error("missing value for " + arg);
+			}
+			(arg == "--variants" ? config.variantManifest : config.variant) = value;
+			i++;
+		}
+		else
+		{
+			throw std::runtime_error("unknown option: " + arg);
+		}
+	}
+
+	// A bundle is recorded once and reused, so there would be nothing for the recording threads to do
+	if (config.recordThreads > 0)
+	{
+		config.commandBundles = false;
+	}
+
+	if (config.pipelineThreads == 0)
+	{
+		uint32_t cores = std::thread::hardware_concurrency();
+		config.pipelineThreads = cores > 1 ? cores - 1 : 1;
+	}
+
+	return config;
+}
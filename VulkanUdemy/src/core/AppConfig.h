@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Which present modes the frame pacer prefers
+enum class PresentPolicy
+{
+	LowLatency,		// MAILBOX, else FIFO
+	Immediate,		// IMMEDIATE: lowest latency, tears
+	PowerSaving,	// FIFO: one frame per vblank
+	Relaxed			// FIFO_RELAXED: late frames tear instead of waiting a whole vblank
+};
+
+// Startup options, filled from the command line
+struct AppConfig
+{
+	uint32_t framesInFlight = 2;	// size of the per-frame resource ring
+	uint32_t benchmarkFrames = 0;	// run this many frames, print stats and exit (0 = run until closed)
+	bool headless = false;			// render into offscreen images, no window or surface
+	bool benchmarkStartup = false;	// print startup timings and exit before the first frame
+	uint32_t startupThreads = 0;	// threads for the startup stages (0 = one per core, 1 = one after another)
+	bool benchmarkMesh = false;		// draw 1K..10M triangle grids and print triangles/sec
+	uint32_t meshBenchmarkMaxTriangles = 10000000;
+	bool benchmarkAllocator = false;	// allocate/free churn: sub-allocator vs vkAllocateMemory
+	uint32_t allocatorBenchmarkLive = 2000;
+	bool benchmarkDefrag = false;		// fragment device memory on purpose and time the defragmenter
+	uint32_t defragBudgetKB = 4096;		// bytes the defragmenter may copy per frame (0 = off)
+	bool benchmarkUpload = false;		// staging ring vs per-upload staging buffers, 64 B .. 64 MB
+	uint32_t stagingRingMB = 32;
+	bool transferQueue = true;			// upload on a dedicated transfer queue family when the device has one
+	uint32_t benchmarkStreamMB = 0;		// upload this many MB per frame while drawing and report queue overlap (0 = off)
+	uint32_t frameArenaKB = 1024;		// per-frame uniform data, bound with dynamic offsets
+	uint32_t benchmarkFrameAllocObjects = 0;	// per-object constants for this many objects a frame: frame arena vs a buffer each (0 = off)
+	bool benchmarkReplace = false;		// swap the drawn geometry every few frames: deletion queue vs vkDeviceWaitIdle
+	bool benchmarkResize = false;		// resize the window every frame and report the worst frame time
+	uint32_t recordThreads = 0;			// record the frame's draws into secondaries on this many threads (0 = inline; turns bundles off)
+	uint32_t benchmarkRecordDraws = 0;	// record this many draws on 1..core count threads and print draws/sec (0 = off)
+	bool dispatchTables = true;			// per-frame device calls through vkGetDeviceProcAddr pointers instead of the loader's exports
+	uint32_t benchmarkDispatchDraws = 0;	// record this many draws through the loader's exports and the device table (0 = off)
+	bool benchmarkJobs = false;			// job system spawn cost and parallel-for scaling, 1 .. core count threads
+	bool commandBundles = true;			// record the static render pass once per framebuffer and re-execute it
+	uint32_t benchmarkBundleDraws = 0;	// static scene of this many draws: frame CPU time with and without bundles (0 = off)
+	PresentPolicy presentPolicy = PresentPolicy::LowLatency;
+	uint32_t fpsLimit = 0;				// frame pacer cap; input is sampled as late as the cap allows (0 = off)
+	bool hostAllocator = true;			// give the driver HostAllocator callbacks and count its host allocations
+	bool profiler = true;				// CPU scopes and GPU timestamps; cheap enough to leave on
+	std::string traceFile;				// write the profiler's Chrome trace here on exit (empty = don't)
+
+	std::string pipelineCachePath = "pipeline_cache.bin";	// empty = don't persist
+	uint32_t pipelineCacheCheckpointFrames = 0;				// also save every N frames (0 = only at shutdown)
+	uint32_t pipelineThreads = 0;							// pipeline compiler workers (0 = one per spare core)
+
+	std::string shaderCacheDir = "assets/shaders/cache";	// compiled SPIR-V, keyed by source + defines hash
+	bool hotReload = true;									// compile GLSL at runtime and rebuild pipelines on edit
+	std::string variantManifest = "assets/shaders/variants.txt";	// shader variants to precompile
+	std::string variant;									// draw this manifest variant instead of the plain triangle
+};
+
+AppConfig parseAppConfig(int argc, char** argv);
@@ -0,0 +1,104 @@
+#include "CommandBundle.h"
+#include "Hash.h"
+#include "HostAllocator.h"
+#include "VulkanDispatch.h"
+
+#include <stdexcept>
+
+void CommandBundle::create(VkDevice device_, uint32_t queueFamily, DeletionQueue* deletionQueue_)
+{
+	device = device_;
+	deletionQueue = deletionQueue_;
+
+	// Bundles are freed one at a time once retired, never reset
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamily;
+	if (vkCreateCommandPool(device, &poolInfo, hostCallbacks(), &commandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create bundle command pool!");
+	}
+}
+
+void CommandBundle::destroy()
+{
+	if (commandPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// Destroying the pool frees whatever is still allocated from it
+	vkDestroyCommandPool(device, commandPool, hostCallbacks());
+	commandPool = VK_NULL_HANDLE;
+	targets.clear();
+}
+
+void CommandBundle::invalidate()
+{
+	for (Target& target : targets)
+	{
+		retire(target);
+	}
+}
+
+void CommandBundle::retire(Target& target)
+{
+	if (target.commandBuffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	VkDevice d = device;
+	VkCommandPool pool = commandPool;
+	VkCommandBuffer commandBuffer = target.commandBuffer;
+	deletionQueue->push([d, pool, commandBuffer] { vkFreeCommandBuffers(d, pool, 1, &commandBuffer); });
+	target.commandBuffer = VK_NULL_HANDLE;
+}
+
+VkCommandBuffer CommandBundle::get(uint32_t targetIndex, const VkCommandBufferInheritanceInfo& inheritance, uint64_t contentKey, const Record& record)
+{
+	if (targetIndex >= targets.size())
+	{
+		targets.resize(targetIndex + 1);
+	}
+	Target& target = targets[targetIndex];
+
+	uint64_t key = hashCombine(contentKey, inheritance.renderPass);
+	key = hashCombine(key, inheritance.subpass);
+	key = hashCombine(key, inheritance.framebuffer);
+	if (target.commandBuffer != VK_NULL_HANDLE && target.key == key)
+	{
+		stats.reused++;
+		return target.commandBuffer;
+	}
+	retire(target);
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	allocInfo.commandBufferCount = 1;
+	if (vkAllocateCommandBuffers(device, &allocInfo, &target.commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate bundle command buffer!");
+	}
+
+	// SIMULTANEOUS_USE: the same bundle is executed by every frame in flight that renders to this target
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+	if (vkd().vkBeginCommandBuffer(target.commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to begin recording bundle!");
+	}
+	record(target.commandBuffer);
+	if (vkd().vkEndCommandBuffer(target.commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to record bundle!");
+	}
+
+	target.key = key;
+	stats.recorded++;
+	return target.commandBuffer;
+}
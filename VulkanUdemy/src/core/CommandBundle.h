@@ -0,0 +1,51 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "DeletionQueue.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct BundleStats
+{
+	uint64_t recorded = 0;	// secondaries (re-)recorded
+	uint64_t reused = 0;	// frames that executed a bundle as it was
+};
+
+// Render pass contents recorded once per target (framebuffer) into a SIMULTANEOUS_USE secondary and executed
+// again every frame until they change: a static pass costs one vkCmdExecuteCommands instead of a re-record.
+// A bundle is re-recorded when invalidate() was called (the dirty flag), when the caller's content key changes
+// (pipelines, buffers, draw counts: anything the commands bake in) or when the inheritance does. Call
+// invalidate() when the framebuffers are destroyed: a new one can reuse an old handle value. Replaced
+// secondaries may still be pending on frames in flight, so they are freed through the deletion queue.
+class CommandBundle
+{
+public:
+	typedef std::function<void(VkCommandBuffer commandBuffer)> Record;
+
+	void create(VkDevice device, uint32_t queueFamily, DeletionQueue* deletionQueue);
+	// Call after DeletionQueue::destroy(), which may still free bundles into the pool
+	void destroy();
+
+	void invalidate();
+	// Ready for vkCmdExecuteCommands in a pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	VkCommandBuffer get(uint32_t targetIndex, const VkCommandBufferInheritanceInfo& inheritance, uint64_t contentKey, const Record& record);
+
+	const BundleStats& getStats() const { return stats; }
+
+private:
+	struct Target
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint64_t key = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	DeletionQueue* deletionQueue = nullptr;
+	std::vector<Target> targets;
+	BundleStats stats;
+
+	void retire(Target& target);
+};
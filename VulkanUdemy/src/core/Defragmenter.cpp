@@ -0,0 +1,379 @@
+#include "Defragmenter.h"
+#include "HostAllocator.h"
+#include "VulkanDispatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+// Frames to wait before searching again when the other blocks had no room
+static const uint64_t RETRY_FRAMES = 120;
+
+void Defragmenter::create(DeviceAllocator* allocator_, VkDeviceSize bytesPerFrame_, float maxOccupancy_)
+{
+	allocator = allocator_;
+	device = allocator->getDevice();
+	bytesPerFrame = bytesPerFrame_;
+	maxOccupancy = maxOccupancy_;
+}
+
+void Defragmenter::destroy()
+{
+	update(UINT64_MAX, 0);
+	if (active)
+	{
+		allocator->setEvacuating(sourcePool, sourceBlock, false);
+		active = false;
+	}
+	queue.clear();
+	movables.clear();
+}
+
+void Defragmenter::addBuffer(VkBuffer* buffer, Allocation* allocation, VkDeviceSize size, VkBufferUsageFlags usage, std::function<void()> onMoved)
+{
+	const VkBufferUsageFlags transfer = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	if ((usage & transfer) != transfer)
+	{
+		throw std::runtime_error("movable buffers need TRANSFER_SRC and TRANSFER_DST usage!");
+	}
+
+	Movable& movable = movables[allocation];
+	movable.buffer = buffer;
+	movable.allocation = allocation;
+	movable.bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	movable.bufferInfo.size = size;
+	movable.bufferInfo.usage = usage;
+	movable.bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	movable.onMoved = std::move(onMoved);
+	exhausted = false;
+}
+
+void Defragmenter::addImage(VkImage* image, Allocation* allocation, const VkImageCreateInfo& imageInfo, VkImageLayout layout,
+	VkImageAspectFlags aspect, std::function<void()> onMoved)
+{
+	if (layout != VK_IMAGE_LAYOUT_UNDEFINED &&
+		(imageInfo.usage & (VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT)) != (VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+	{
+		throw std::runtime_error("movable images with contents need TRANSFER_SRC and TRANSFER_DST usage!");
+	}
+	if (imageInfo.sharingMode != VK_SHARING_MODE_EXCLUSIVE)
+	{
+		throw std::runtime_error("movable images must use exclusive sharing!");
+	}
+
+	Movable& movable = movables[allocation];
+	movable.image = image;
+	movable.allocation = allocation;
+	movable.imageInfo = imageInfo;
+	movable.imageInfo.pNext = nullptr;
+	movable.imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	movable.layout = layout;
+	movable.aspect = aspect;
+	movable.onMoved = std::move(onMoved);
+	exhausted = false;
+}
+
+void Defragmenter::remove(const Allocation* allocation)
+{
+	movables.erase(allocation);
+	queue.erase(std::remove(queue.begin(), queue.end(), allocation), queue.end());
+}
+
+void Defragmenter::record(VkCommandBuffer commandBuffer)
+{
+	if (bytesPerFrame == 0)
+	{
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	// One block at a time: the next search waits until the last one's originals are gone
+	if (!active && retired.empty() && frameNumber >= retryFrame)
+	{
+		beginPass();
+	}
+	if (queue.empty())
+	{
+		return;
+	}
+
+	VkMemoryBarrier before{};
+	before.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	before.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	before.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkd().vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0, nullptr, 0, nullptr);
+
+	// Always at least one move, so resources bigger than the budget still get through
+	VkDeviceSize frameBytes = 0;
+	std::vector<VkImageMemoryBarrier> finalBarriers;
+	while (!queue.empty())
+	{
+		Movable& movable = movables.at(queue.back());
+		VkDeviceSize size = movable.allocation->size;
+		if (frameBytes > 0 && frameBytes + size > bytesPerFrame)
+		{
+			break;
+		}
+		if (!move(commandBuffer, movable, finalBarriers))
+		{
+			endPass(true);
+			break;
+		}
+		queue.pop_back();
+		frameBytes += size;
+	}
+
+	VkMemoryBarrier after{};
+	after.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	after.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	after.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkd().vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &after, 0, nullptr,
+		static_cast<uint32_t>(finalBarriers.size()), finalBarriers.data());
+
+	if (frameBytes > 0)
+	{
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats.activeFrames++;
+		stats.maxFrameBytes = std::max(stats.maxFrameBytes, frameBytes);
+		stats.recordMs += ms;
+		stats.maxRecordMs = std::max(stats.maxRecordMs, ms);
+	}
+}
+
+void Defragmenter::update(uint64_t frameNumber_, uint32_t framesInFlight)
+{
+	frameNumber = frameNumber_;
+
+	for (size_t i = 0; i < retired.size();)
+	{
+		const Retired& r = retired[i];
+		if (frameNumber >= r.frameNumber + framesInFlight)
+		{
+			if (r.buffer != VK_NULL_HANDLE)
+			{
+				allocator->destroyBuffer(r.buffer, r.allocation);
+			}
+			else
+			{
+				allocator->destroyImage(r.image, r.allocation);
+			}
+			retired[i] = retired.back();
+			retired.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	if (active && queue.empty() && retired.empty())
+	{
+		endPass(false);
+	}
+}
+
+void Defragmenter::printStats() const
+{
+	const double MB = 1024.0 * 1024.0;
+	uint32_t frames = std::max(stats.activeFrames, 1u);
+
+	printf("defragmenter: %u passes (%u aborted), %u moves, %.2f MB moved, %u blocks freed\n",
+		stats.passes, stats.abortedPasses, stats.moves, stats.bytesMoved / MB, stats.blocksFreed);
+	printf("  per active frame (%u frames, budget %.2f MB): %.2f MB avg / %.2f MB max, record %.3f ms avg / %.3f ms max\n",
+		stats.activeFrames, bytesPerFrame / MB, stats.bytesMoved / MB / frames, stats.maxFrameBytes / MB,
+		stats.recordMs / frames, stats.maxRecordMs);
+}
+
+void Defragmenter::beginPass()
+{
+	std::vector<DeviceAllocator::BlockInfo> blocks = allocator->getBlocks();
+
+	std::unordered_map<uint64_t, uint32_t> registered;
+	for (const auto& [key, movable] : movables)
+	{
+		if (movable.allocation->pool != UINT32_MAX)
+		{
+			registered[(static_cast<uint64_t>(movable.allocation->pool) << 32) | movable.allocation->block]++;
+		}
+	}
+
+	// The sparsest fully registered block whose contents the rest of its pool could take
+	VkDeviceSize blockSize = allocator->getBlockSize();
+	const DeviceAllocator::BlockInfo* source = nullptr;
+	for (const DeviceAllocator::BlockInfo& block : blocks)
+	{
+		auto it = registered.find((static_cast<uint64_t>(block.pool) << 32) | block.block);
+		if (block.allocationCount == 0 || it == registered.end() || it->second != block.allocationCount ||
+			block.nodeBytes > static_cast<VkDeviceSize>(maxOccupancy * blockSize))
+		{
+			continue;
+		}
+
+		VkDeviceSize room = 0;
+		for (const DeviceAllocator::BlockInfo& other : blocks)
+		{
+			if (other.pool == block.pool && other.block != block.block && !other.evacuating)
+			{
+				room += blockSize - other.nodeBytes;
+			}
+		}
+		if (room >= block.nodeBytes && (source == nullptr || block.nodeBytes < source->nodeBytes))
+		{
+			source = &block;
+		}
+	}
+
+	exhausted = source == nullptr;
+	if (exhausted)
+	{
+		return;
+	}
+
+	active = true;
+	sourcePool = source->pool;
+	sourceBlock = source->block;
+	allocator->setEvacuating(sourcePool, sourceBlock, true);
+	stats.passes++;
+
+	for (const auto& [key, movable] : movables)
+	{
+		if (movable.allocation->pool == sourcePool && movable.allocation->block == sourceBlock)
+		{
+			queue.push_back(key);
+		}
+	}
+	// Big ones first, while the destination blocks still have large holes
+	std::sort(queue.begin(), queue.end(), [](const Allocation* a, const Allocation* b) { return a->size < b->size; });
+}
+
+void Defragmenter::endPass(bool aborted)
+{
+	if (aborted)
+	{
+		stats.abortedPasses++;
+		retryFrame = frameNumber + RETRY_FRAMES;
+		exhausted = true;
+		queue.clear();
+	}
+
+	// The allocator releases a block as soon as its last allocation is freed
+	if (!aborted && !allocator->hasBlock(sourcePool, sourceBlock))
+	{
+		stats.blocksFreed++;
+	}
+	else
+	{
+		allocator->setEvacuating(sourcePool, sourceBlock, false);
+	}
+	active = false;
+}
+
+bool Defragmenter::move(VkCommandBuffer commandBuffer, Movable& movable, std::vector<VkImageMemoryBarrier>& finalBarriers)
+{
+	Allocation target;
+	if (!allocator->allocateMove(*movable.allocation, target))
+	{
+		return false;
+	}
+
+	Retired original{ VK_NULL_HANDLE, VK_NULL_HANDLE, *movable.allocation, frameNumber };
+
+	if (movable.buffer != nullptr)
+	{
+		VkBuffer buffer;
+		if (vkCreateBuffer(device, &movable.bufferInfo, hostCallbacks(), &buffer) != VK_SUCCESS)
+		{
+			allocator->free(target);
+			throw std::runtime_error("failed to create buffer!");
+		}
+		if (vkBindBufferMemory(device, buffer, target.memory, target.offset) != VK_SUCCESS)
+		{
+			vkDestroyBuffer(device, buffer, hostCallbacks());
+			allocator->free(target);
+			return false;
+		}
+
+		VkBufferCopy region{};
+		region.size = movable.bufferInfo.size;
+		vkd().vkCmdCopyBuffer(commandBuffer, *movable.buffer, buffer, 1, &region);
+
+		original.buffer = *movable.buffer;
+		*movable.buffer = buffer;
+	}
+	else
+	{
+		VkImage image;
+		if (vkCreateImage(device, &movable.imageInfo, hostCallbacks(), &image) != VK_SUCCESS)
+		{
+			allocator->free(target);
+			throw std::runtime_error("failed to create image!");
+		}
+		if (vkBindImageMemory(device, image, target.memory, target.offset) != VK_SUCCESS)
+		{
+			vkDestroyImage(device, image, hostCallbacks());
+			allocator->free(target);
+			return false;
+		}
+
+		VkImageMemoryBarrier barriers[2]{};
+		for (VkImageMemoryBarrier& barrier : barriers)
+		{
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.subresourceRange = { movable.aspect, 0, movable.imageInfo.mipLevels, 0, movable.imageInfo.arrayLayers };
+		}
+
+		// UNDEFINED: nothing worth copying, the owner renders into the new image before reading it
+		if (movable.layout != VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			barriers[0].image = *movable.image;
+			barriers[0].oldLayout = movable.layout;
+			barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barriers[1].image = image;
+			barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkd().vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+			std::vector<VkImageCopy> regions(movable.imageInfo.mipLevels);
+			for (uint32_t mip = 0; mip < movable.imageInfo.mipLevels; mip++)
+			{
+				VkImageCopy& region = regions[mip];
+				region.srcSubresource = { movable.aspect, mip, 0, movable.imageInfo.arrayLayers };
+				region.dstSubresource = region.srcSubresource;
+				region.extent.width = std::max(movable.imageInfo.extent.width >> mip, 1u);
+				region.extent.height = std::max(movable.imageInfo.extent.height >> mip, 1u);
+				region.extent.depth = std::max(movable.imageInfo.extent.depth >> mip, 1u);
+			}
+			vkd().vkCmdCopyImage(commandBuffer, *movable.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(regions.size()), regions.data());
+
+			VkImageMemoryBarrier& restore = barriers[1];
+			restore.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			restore.newLayout = movable.layout;
+			restore.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			restore.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			finalBarriers.push_back(restore);
+		}
+
+		original.image = *movable.image;
+		*movable.image = image;
+	}
+
+	retired.push_back(original);
+	*movable.allocation = target;
+
+	stats.moves++;
+	stats.bytesMoved += target.size;
+
+	if (movable.onMoved)
+	{
+		movable.onMoved();
+	}
+	return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+struct DefragStats
+{
+	uint32_t passes = 0;			// blocks picked for evacuation
+	uint32_t abortedPasses = 0;		// the other blocks ran out of room part way
+	uint32_t moves = 0;
+	uint64_t bytesMoved = 0;
+	uint32_t blocksFreed = 0;
+	uint32_t activeFrames = 0;		// frames that recorded at least one copy
+	VkDeviceSize maxFrameBytes = 0;
+	double recordMs = 0.0;			// CPU time spent in record() over the active frames
+	double maxRecordMs = 0.0;
+};
+
+// Empties sparsely used DeviceAllocator blocks a little every frame: registered buffers and images are
+// copied into denser blocks within a byte budget, the owner's handle and allocation are patched in place,
+// and the originals are destroyed once no frame in flight can still read them.
+// A block is only picked when every allocation in it is registered, otherwise it could never be freed.
+class Defragmenter
+{
+public:
+	// bytesPerFrame = 0 disables it; blocks above maxOccupancy are left alone
+	void create(DeviceAllocator* allocator, VkDeviceSize bytesPerFrame, float maxOccupancy = 0.5f);
+	// Call after vkDeviceWaitIdle
+	void destroy();
+
+	// The handle and allocation must stay at these addresses until remove(). Buffers need TRANSFER_SRC and
+	// TRANSFER_DST usage; onMoved runs after the patch (descriptor writes, views, ...).
+	void addBuffer(VkBuffer* buffer, Allocation* allocation, VkDeviceSize size, VkBufferUsageFlags usage, std::function<void()> onMoved = nullptr);
+	// The image must be in `layout` between frames; UNDEFINED means its contents can be dropped (render targets).
+	// Exclusive sharing only.
+	void addImage(VkImage* image, Allocation* allocation, const VkImageCreateInfo& imageInfo, VkImageLayout layout,
+		VkImageAspectFlags aspect, std::function<void()> onMoved = nullptr);
+	void remove(const Allocation* allocation);
+
+	// Records this frame's copies; call outside a render pass, before the registered handles are used
+	void record(VkCommandBuffer commandBuffer);
+	// Destroys originals whose copies frames up to frameNumber - framesInFlight recorded
+	void update(uint64_t frameNumber, uint32_t framesInFlight);
+
+	// Nothing left to move or retire and the last search found no sparse block
+	bool idle() const { return bytesPerFrame == 0 || (!active && retired.empty() && exhausted); }
+	const DefragStats& getStats() const { return stats; }
+	void printStats() const;
+
+private:
+	struct Movable
+	{
+		VkBuffer* buffer = nullptr;
+		VkImage* image = nullptr;
+		Allocation* allocation = nullptr;
+		VkBufferCreateInfo bufferInfo{};
+		VkImageCreateInfo imageInfo{};
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageAspectFlags aspect = 0;
+		std::function<void()> onMoved;
+	};
+
+	struct Retired
+	{
+		VkBuffer buffer;
+		VkImage image;
+		Allocation allocation;
+		uint64_t frameNumber;
+	};
+
+	DeviceAllocator* allocator = nullptr;
+	VkDevice device = VK_NULL_HANDLE;
+	VkDeviceSize bytesPerFrame = 0;
+	float maxOccupancy = 0.5f;
+
+	std::unordered_map<const Allocation*, Movable> movables;
+	std::vector<const Allocation*> queue;	// moves left in the current pass, largest at the back
+	std::vector<Retired> retired;
+
+	bool active = false;		// a block is being evacuated
+	uint32_t sourcePool = 0;
+	uint32_t sourceBlock = 0;
+	bool exhausted = false;
+	uint64_t frameNumber = 0;
+	uint64_t retryFrame = 0;	// after an aborted pass, don't search again before this frame
+
+	DefragStats stats;
+
+	void beginPass();
+	void endPass(bool aborted);
+	// False, with nothing changed, if no block has room or the new resource can't be bound; the pass then aborts
+	bool move(VkCommandBuffer commandBuffer, Movable& movable, std::vector<VkImageMemoryBarrier>& finalBarriers);
+};
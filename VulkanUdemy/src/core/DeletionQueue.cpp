@@ -0,0 +1,111 @@
+#include "DeletionQueue.h"
+#include "HostAllocator.h"
+
+#include <algorithm>
+
+void DeletionQueue::create(DeviceAllocator* allocator_)
+{
+	allocator = allocator_;
+	device = allocator->getDevice();
+}
+
+void DeletionQueue::destroy()
+{
+	while (!entries.empty())
+	{
+		run(entries.front());
+		entries.pop_front();
+	}
+}
+
+void DeletionQueue::destroyBuffer(VkBuffer buffer, const Allocation& allocation)
+{
+	queue(VK_OBJECT_TYPE_BUFFER, reinterpret_cast<uint64_t>(buffer), allocation);
+}
+
+void DeletionQueue::destroyImage(VkImage image, const Allocation& allocation)
+{
+	queue(VK_OBJECT_TYPE_IMAGE, reinterpret_cast<uint64_t>(image), allocation);
+}
+
+void DeletionQueue::destroyImageView(VkImageView imageView)
+{
+	queue(VK_OBJECT_TYPE_IMAGE_VIEW, reinterpret_cast<uint64_t>(imageView));
+}
+
+void DeletionQueue::destroyFramebuffer(VkFramebuffer framebuffer)
+{
+	queue(VK_OBJECT_TYPE_FRAMEBUFFER, reinterpret_cast<uint64_t>(framebuffer));
+}
+
+void DeletionQueue::destroySwapchain(VkSwapchainKHR swapchain)
+{
+	queue(VK_OBJECT_TYPE_SWAPCHAIN_KHR, reinterpret_cast<uint64_t>(swapchain));
+}
+
+void DeletionQueue::destroySemaphore(VkSemaphore semaphore)
+{
+	queue(VK_OBJECT_TYPE_SEMAPHORE, reinterpret_cast<uint64_t>(semaphore));
+}
+
+void DeletionQueue::destroyFence(VkFence fence)
+{
+	queue(VK_OBJECT_TYPE_FENCE, reinterpret_cast<uint64_t>(fence));
+}
+
+void DeletionQueue::push(std::function<void()> destroy)
+{
+	queue(VK_OBJECT_TYPE_UNKNOWN, 0);
+	entries.back().callback = std::move(destroy);
+}
+
+void DeletionQueue::queue(VkObjectType type, uint64_t handle, const Allocation& allocation)
+{
+	entries.push_back({ type, handle, allocation, nullptr, frameNumber });
+	stats.queued++;
+	stats.maxPending = std::max(stats.maxPending, static_cast<uint32_t>(entries.size()));
+}
+
+void DeletionQueue::update(uint64_t frameNumber_, uint32_t framesInFlight)
+{
+	frameNumber = frameNumber_;
+
+	// Entries are in frame order, so stop at the first one a frame in flight may still use
+	while (!entries.empty() && frameNumber >= entries.front().frameNumber + framesInFlight)
+	{
+		run(entries.front());
+		entries.pop_front();
+	}
+}
+
+void DeletionQueue::run(Entry& entry)
+{
+	switch (entry.type)
+	{
+	case VK_OBJECT_TYPE_BUFFER:
+		allocator->destroyBuffer(reinterpret_cast<VkBuffer>(entry.handle), entry.allocation);
+		break;
+	case VK_OBJECT_TYPE_IMAGE:
+		allocator->destroyImage(reinterpret_cast<VkImage>(entry.handle), entry.allocation);
+		break;
+	case VK_OBJECT_TYPE_IMAGE_VIEW:
+		vkDestroyImageView(device, reinterpret_cast<VkImageView>(entry.handle), hostCallbacks());
+		break;
+	case VK_OBJECT_TYPE_FRAMEBUFFER:
+		vkDestroyFramebuffer(device, reinterpret_cast<VkFramebuffer>(entry.handle), hostCallbacks());
+		break;
+	case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+		vkDestroySwapchainKHR(device, reinterpret_cast<VkSwapchainKHR>(entry.handle), hostCallbacks());
+		break;
+	case VK_OBJECT_TYPE_SEMAPHORE:
+		vkDestroySemaphore(device, reinterpret_cast<VkSemaphore>(entry.handle), hostCallbacks());
+		break;
+	case VK_OBJECT_TYPE_FENCE:
+		vkDestroyFence(device, reinterpret_cast<VkFence>(entry.handle), hostCallbacks());
+		break;
+	default:
+		entry.callback();
+		break;
+	}
+	stats.destroyed++;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+struct DeletionStats
+{
+	uint64_t queued = 0;
+	uint64_t destroyed = 0;
+	uint32_t maxPending = 0;
+};
+
+// Destroys replaced resources once no frame in flight can still use them, so they can be swapped at runtime
+// without vkDeviceWaitIdle. Everything queued between two update() calls is tagged with the frame being
+// recorded and destroyed framesInFlight frames later, after that frame's fence has signalled. FIFO order.
+class DeletionQueue
+{
+public:
+	void create(DeviceAllocator* allocator);
+	// Call after vkDeviceWaitIdle; destroys everything still queued
+	void destroy();
+
+	void destroyBuffer(VkBuffer buffer, const Allocation& allocation);
+	void destroyImage(VkImage image, const Allocation& allocation);
+	void destroyImageView(VkImageView imageView);
+	void destroyFramebuffer(VkFramebuffer framebuffer);
+	void destroySwapchain(VkSwapchainKHR swapchain);
+	void destroySemaphore(VkSemaphore semaphore);
+	void destroyFence(VkFence fence);
+	// Anything else (owning objects, several handles at once)
+	void push(std::function<void()> destroy);
+
+	// Call once per frame after the frame fence wait
+	void update(uint64_t frameNumber, uint32_t framesInFlight);
+
+	size_t pendingCount() const { return entries.size(); }
+	const DeletionStats& getStats() const { return stats; }
+
+private:
+	struct Entry
+	{
+		VkObjectType type;
+		uint64_t handle;	// non-dispatchable: a pointer on 64-bit builds, a uint64_t on 32-bit; reinterpret_cast covers both
+		Allocation allocation;
+		std::function<void()> callback;	// VK_OBJECT_TYPE_UNKNOWN
+		uint64_t frameNumber;
+	};
+
+	DeviceAllocator* allocator = nullptr;
+	VkDevice device = VK_NULL_HANDLE;
+	std::deque<Entry> entries;
+	uint64_t frameNumber = 0;
+	DeletionStats stats;
+
+	void queue(VkObjectType type, uint64_t handle, const Allocation& allocation = Allocation{});
+	void run(Entry& entry);
+};
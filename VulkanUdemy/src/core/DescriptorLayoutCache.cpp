@@ -0,0 +1,119 @@
+#include "DescriptorLayoutCache.h"
+#include "Hash.h"
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+static bool sameBindings(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b)
+{
+	if (a.size() != b.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].binding != b[i].binding || a[i].descriptorType != b[i].descriptorType ||
+			a[i].descriptorCount != b[i].descriptorCount || a[i].stageFlags != b[i].stageFlags)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void DescriptorLayoutCache::create(VkDevice device_)
+{
+	device = device_;
+}
+
+void DescriptorLayoutCache::destroy()
+{
+	for (auto& [hash, entry] : layouts)
+	{
+		vkDestroyDescriptorSetLayout(device, entry.layout, hostCallbacks());
+	}
+	layouts.clear();
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::acquire(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+	uint64_t hash = hashCombine(1469598103934665603ull, bindings.size());
+	for (const VkDescriptorSetLayoutBinding& b : bindings)
+	{
+		hash = hashCombine(hash, b.binding);
+		hash = hashCombine(hash, b.descriptorType);
+		hash = hashCombine(hash, b.descriptorCount);
+		hash = hashCombine(hash, b.stageFlags);
+	}
+
+	auto it = layouts.find(hash);
+	if (it != layouts.end())
+	{
+		if (!sameBindings(it->second.bindings, bindings))
+		{
+			throw std::runtime_error("descriptor set layout hash collision!");
+		}
+		return it->second.layout;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	VkDescriptorSetLayout layout;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostCallbacks(), &layout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+
+	layouts.emplace(hash, Entry{ bindings, layout });
+	return layout;
+}
+
+PipelineLayoutDesc DescriptorLayoutCache::describe(const ShaderReflection& reflection)
+{
+	PipelineLayoutDesc desc;
+
+	// Bindings are sorted by set; sets skipped by the shaders still need an (empty) layout
+	for (const ReflectedBinding& b : reflection.bindings)
+	{
+		if (b.set >= PipelineLayoutDesc::MAX_SETS)
+		{
+			throw std::runtime_error("descriptor set " + std::to_string(b.set) + " is out of range!");
+		}
+		desc.setLayoutCount = std::max(desc.setLayoutCount, b.set + 1);
+	}
+
+	std::vector<VkDescriptorSetLayoutBinding> setBindings;
+	for (uint32_t set = 0; set < desc.setLayoutCount; set++)
+	{
+		setBindings.clear();
+		for (const ReflectedBinding& b : reflection.bindings)
+		{
+			if (b.set != set)
+			{
+				continue;
+			}
+
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = b.binding;
+			// Uniform data comes from the FrameArena, selected per draw by dynamic offset
+			binding.descriptorType = b.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : b.type;
+			binding.descriptorCount = b.count;
+			binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+			setBindings.push_back(binding);
+		}
+		desc.setLayouts[set] = acquire(setBindings);
+	}
+
+	if (reflection.pushConstantSize > 0)
+	{
+		desc.pushConstantStages = VK_SHADER_STAGE_ALL_GRAPHICS;
+		desc.pushConstantSize = reflection.pushConstantSize;
+	}
+
+	return desc;
+}
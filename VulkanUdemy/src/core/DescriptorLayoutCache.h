@@ -0,0 +1,38 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "PipelineDesc.h"
+#include "ShaderReflection.h"
+
+#include <unordered_map>
+#include <vector>
+
+// Deduplicates VkDescriptorSetLayouts by their bindings and turns shader reflection into a
+// PipelineLayoutDesc. Pipelines declaring the same sets end up with identical set layouts,
+// so sets bound once stay valid across pipeline switches.
+class DescriptorLayoutCache
+{
+public:
+	void create(VkDevice device);
+	void destroy();
+
+	// bindings must not use immutable samplers
+	VkDescriptorSetLayout acquire(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+	// Stage flags are widened to all graphics stages, so a set or push-constant block used by
+	// different stages in different pipelines still produces the same, compatible layout.
+	// Uniform blocks become UNIFORM_BUFFER_DYNAMIC bindings.
+	PipelineLayoutDesc describe(const ShaderReflection& reflection);
+
+	uint32_t layoutCount() const { return static_cast<uint32_t>(layouts.size()); }
+
+private:
+	struct Entry
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		VkDescriptorSetLayout layout;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	std::unordered_map<uint64_t, Entry> layouts;
+};
@@ -0,0 +1,579 @@
+#include "DeviceAllocator.h"
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+// Smallest buddy node; also the granularity below which buffers and images may share blocks
+static const VkDeviceSize MIN_NODE_SIZE = 256;
+
+void DeviceAllocator::create(VkPhysicalDevice gpu_, VkDevice device_, VkDeviceSize blockSize_)
+{
+	gpu = gpu_;
+	device = device_;
+
+	vkGetPhysicalDeviceMemoryProperties(gpu, &memProperties);
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(gpu, &properties);
+	separateOptimal = properties.limits.bufferImageGranularity > MIN_NODE_SIZE;
+	maxDeviceAllocations = properties.limits.maxMemoryAllocationCount;
+	// The instance asks for 1.1, so a 1.1 device has the 1.1 entry points
+	dedicatedQueries = properties.apiVersion >= VK_API_VERSION_1_1;
+
+	// Buddy blocks must be a power of two
+	blockSize = MIN_NODE_SIZE;
+	levelCount = 1;
+	while (blockSize < blockSize_)
+	{
+		blockSize *= 2;
+		levelCount++;
+	}
+
+	pools.resize(memProperties.memoryTypeCount * 2);
+	for (uint32_t i = 0; i < pools.size(); i++)
+	{
+		pools[i].memoryType = i / 2;
+	}
+}
+
+void DeviceAllocator::destroy()
+{
+	for (Pool& pool : pools)
+	{
+		for (auto& block : pool.blocks)
+		{
+			if (block)
+			{
+				freeDeviceMemory(block->memory);
+			}
+		}
+	}
+	pools.clear();
+
+	for (const Dedicated& d : dedicated)
+	{
+		freeDeviceMemory(d.memory);
+	}
+	dedicated.clear();
+}
+
+Allocation DeviceAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceKind kind, bool forceDedicated)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Allocation allocation;
+	allocation.memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+	allocation.size = requirements.size;
+
+	// A node is aligned to its own size, so rounding up to the alignment is enough
+	VkDeviceSize size = std::max({ requirements.size, requirements.alignment, MIN_NODE_SIZE });
+
+	if (forceDedicated || size > blockSize / 2)
+	{
+		allocation.memory = allocateDeviceMemory(allocation.memoryType, requirements.size, &allocation.mapped);
+		dedicated.push_back({ allocation.memory, requirements.size, allocation.memoryType });
+		return allocation;
+	}
+
+	uint32_t level = levelCount - 1;
+	while (level > 0 && (blockSize >> level) < size)
+	{
+		level--;
+	}
+
+	allocation.pool = allocation.memoryType * 2 + (separateOptimal && kind == ResourceKind::Optimal ? 1 : 0);
+	Pool& pool = pools[allocation.pool];
+
+	uint32_t node = 0;
+	uint32_t blockIndex = UINT32_MAX;
+	for (uint32_t b = 0; b < pool.blocks.size(); b++)
+	{
+		if (pool.blocks[b] && !pool.blocks[b]->evacuating && allocateFromBlock(*pool.blocks[b], level, node))
+		{
+			blockIndex = b;
+			break;
+		}
+	}
+
+	if (blockIndex == UINT32_MAX)
+	{
+		auto empty = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+		blockIndex = static_cast<uint32_t>(empty - pool.blocks.begin());
+		if (empty == pool.blocks.end())
+		{
+			pool.blocks.emplace_back();
+		}
+		pool.blocks[blockIndex] = createBlock(pool.memoryType);
+		allocateFromBlock(*pool.blocks[blockIndex], level, node);
+	}
+
+	place(allocation, blockIndex, node, level);
+	return allocation;
+}
+
+bool DeviceAllocator::allocateMove(const Allocation& source, Allocation& destination)
+{
+	if (source.pool == UINT32_MAX)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Pool& pool = pools[source.pool];
+	std::vector<uint32_t> order;
+	for (uint32_t b = 0; b < pool.blocks.size(); b++)
+	{
+		if (pool.blocks[b] && !pool.blocks[b]->evacuating && b != source.block)
+		{
+			order.push_back(b);
+		}
+	}
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return pool.blocks[a]->nodeBytes > pool.blocks[b]->nodeBytes; });
+
+	for (uint32_t b : order)
+	{
+		uint32_t node = 0;
+		if (allocateFromBlock(*pool.blocks[b], source.level, node))
+		{
+			destination = Allocation{};
+			destination.memoryType = source.memoryType;
+			destination.size = source.size;
+			destination.pool = source.pool;
+			place(destination, b, node, source.level);
+			return true;
+		}
+	}
+	return false;
+}
+
+void DeviceAllocator::free(const Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (allocation.pool == UINT32_MAX)
+	{
+		auto it = std::find_if(dedicated.begin(), dedicated.end(), [&](const Dedicated& d) { return d.memory == allocation.memory; });
+		if (it == dedicated.end())
+		{
+			throw std::runtime_error("freed an unknown dedicated allocation!");
+		}
+		freeDeviceMemory(it->memory);
+		*it = dedicated.back();
+		dedicated.pop_back();
+		return;
+	}
+
+	Pool& pool = pools[allocation.pool];
+	Block& block = *pool.blocks[allocation.block];
+	VkDeviceSize nodeSize = blockSize >> allocation.level;
+	uint32_t node = ((1u << allocation.level) - 1) + static_cast<uint32_t>(allocation.offset / nodeSize);
+	if (block.nodes[node] != NODE_ALLOCATED)
+	{
+		throw std::runtime_error("device memory freed twice!");
+	}
+
+	freeInBlock(block, node, allocation.level);
+	block.allocationCount--;
+	block.usedBytes -= allocation.size;
+	block.nodeBytes -= nodeSize;
+
+	// Give empty blocks back to the driver, but keep one around so churn doesn't thrash vkAllocateMemory
+	if (block.allocationCount == 0)
+	{
+		size_t liveBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const std::unique_ptr<Block>& b) { return b != nullptr; });
+		if (liveBlocks > 1)
+		{
+			freeDeviceMemory(block.memory);
+			pool.blocks[allocation.block].reset();
+		}
+	}
+}
+
+void DeviceAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& allocation)
+{
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, hostCallbacks(), &buffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create buffer!");
+	}
+
+	VkMemoryRequirements memReqs;
+	vkGetBufferMemoryRequirements(device, buffer, &memReqs);
+
+	allocation = allocate(memReqs, properties, ResourceKind::Linear);
+	if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+	{
+		destroyBuffer(buffer, allocation);
+		throw std::runtime_error("failed to bind buffer memory!");
+	}
+}
+
+void DeviceAllocator::destroyBuffer(VkBuffer buffer, const Allocation& allocation)
+{
+	vkDestroyBuffer(device, buffer, hostCallbacks());
+	free(allocation);
+}
+
+void DeviceAllocator::createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, Allocation& allocation)
+{
+	if (vkCreateImage(device, &imageInfo, hostCallbacks(), &image) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create image!");
+	}
+
+	VkMemoryRequirements memReqs;
+	bool dedicatedImage = false;
+	if (dedicatedQueries)
+	{
+		VkMemoryDedicatedRequirements dedicatedReqs{};
+		dedicatedReqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+		VkMemoryRequirements2 memReqs2{};
+		memReqs2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		memReqs2.pNext = &dedicatedReqs;
+		VkImageMemoryRequirementsInfo2 info{};
+		info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+		info.image = image;
+		vkGetImageMemoryRequirements2(device, &info, &memReqs2);
+		memReqs = memReqs2.memoryRequirements;
+		dedicatedImage = dedicatedReqs.prefersDedicatedAllocation || dedicatedReqs.requiresDedicatedAllocation;
+	}
+	else
+	{
+		vkGetImageMemoryRequirements(device, image, &memReqs);
+	}
+
+	ResourceKind kind = imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceKind::Optimal : ResourceKind::Linear;
+	try
+	{
+		allocation = dedicatedImage ? allocateForImage(image, memReqs, properties) : allocate(memReqs, properties, kind);
+	}
+	catch (...)
+	{
+		vkDestroyImage(device, image, hostCallbacks());
+		throw;
+	}
+	if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+	{
+		destroyImage(image, allocation);
+		throw std::runtime_error("failed to bind image memory!");
+	}
+}
+
+void DeviceAllocator::destroyImage(VkImage image, const Allocation& allocation)
+{
+	vkDestroyImage(device, image, hostCallbacks());
+	free(allocation);
+}
+
+uint32_t DeviceAllocator::deviceAllocationCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return liveDeviceAllocations;
+}
+
+std::vector<DeviceAllocator::BlockInfo> DeviceAllocator::getBlocks() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::vector<BlockInfo> blocks;
+	for (uint32_t p = 0; p < pools.size(); p++)
+	{
+		for (uint32_t b = 0; b < pools[p].blocks.size(); b++)
+		{
+			const Block* block = pools[p].blocks[b].get();
+			if (block)
+			{
+				blocks.push_back({ p, b, block->nodeBytes, block->allocationCount, block->evacuating });
+			}
+		}
+	}
+	return blocks;
+}
+
+bool DeviceAllocator::hasBlock(uint32_t pool, uint32_t block) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pool < pools.size() && block < pools[pool].blocks.size() && pools[pool].blocks[block] != nullptr;
+}
+
+void DeviceAllocator::setEvacuating(uint32_t pool, uint32_t block, bool evacuating)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (pool < pools.size() && block < pools[pool].blocks.size() && pools[pool].blocks[block])
+	{
+		pools[pool].blocks[block]->evacuating = evacuating;
+	}
+}
+
+std::vector<HeapStats> DeviceAllocator::getHeapStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::vector<HeapStats> heaps(memProperties.memoryHeapCount);
+	std::vector<VkDeviceSize> freeBytes(memProperties.memoryHeapCount, 0);
+	std::vector<VkDeviceSize> holeBytes(memProperties.memoryHeapCount, 0);
+	for (uint32_t h = 0; h < memProperties.memoryHeapCount; h++)
+	{
+		heaps[h].heapIndex = h;
+		heaps[h].heapSize = memProperties.memoryHeaps[h].size;
+	}
+
+	for (const Pool& pool : pools)
+	{
+		uint32_t heapIndex = memProperties.memoryTypes[pool.memoryType].heapIndex;
+		HeapStats& heap = heaps[heapIndex];
+		for (const auto& block : pool.blocks)
+		{
+			if (!block)
+			{
+				continue;
+			}
+			heap.blockCount++;
+			heap.allocationCount += block->allocationCount;
+			heap.reservedBytes += blockSize;
+			heap.usedBytes += block->usedBytes;
+			heap.wastedBytes += block->nodeBytes - block->usedBytes;
+			VkDeviceSize hole = largestFree(*block);
+			heap.largestFree = std::max(heap.largestFree, hole);
+			holeBytes[heapIndex] += hole;
+			freeBytes[heapIndex] += blockSize - block->nodeBytes;
+		}
+	}
+
+	for (const Dedicated& d : dedicated)
+	{
+		HeapStats& heap = heaps[memProperties.memoryTypes[d.memoryType].heapIndex];
+		heap.dedicatedCount++;
+		heap.allocationCount++;
+		heap.reservedBytes += d.size;
+		heap.usedBytes += d.size;
+	}
+
+	std::vector<HeapStats> used;
+	for (HeapStats& heap : heaps)
+	{
+		VkDeviceSize free = freeBytes[heap.heapIndex];
+		heap.fragmentation = free > 0 ? 1.0f - static_cast<float>(holeBytes[heap.heapIndex]) / static_cast<float>(free) : 0.0f;
+		if (heap.reservedBytes > 0)
+		{
+			used.push_back(heap);
+		}
+	}
+	return used;
+}
+
+void DeviceAllocator::printStats() const
+{
+	const double MB = 1024.0 * 1024.0;
+
+	printf("device memory: %u vkAllocateMemory allocations live (device limit %u)\n", deviceAllocationCount(), maxDeviceAllocations);
+	for (const HeapStats& heap : getHeapStats())
+	{
+		printf("  heap %u (%.0f MB): %u blocks + %u dedicated, %u allocations, %.2f MB used / %.2f MB reserved, %.2f MB lost to rounding, largest hole %.2f MB, fragmentation %.0f%%\n",
+			heap.heapIndex, heap.heapSize / MB, heap.blockCount, heap.dedicatedCount, heap.allocationCount,
+			heap.usedBytes / MB, heap.reservedBytes / MB, heap.wastedBytes / MB, heap.largestFree / MB, heap.fragmentation * 100.0f);
+	}
+}
+
+uint32_t DeviceAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+// A dedicated allocation bound to image alone, which lets the driver lay it out its own way
+Allocation DeviceAllocator::allocateForImage(VkImage image, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Allocation allocation;
+	allocation.memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+	allocation.size = requirements.size;
+
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.image = image;
+	allocation.memory = allocateDeviceMemory(allocation.memoryType, requirements.size, &allocation.mapped, &dedicatedInfo);
+	dedicated.push_back({ allocation.memory, requirements.size, allocation.memoryType });
+	return allocation;
+}
+
+VkDeviceMemory DeviceAllocator::allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, void** mapped, const void* next)
+{
+	if (maxDeviceAllocations > 0 && liveDeviceAllocations >= maxDeviceAllocations)
+	{
+		throw std::runtime_error("out of device memory allocations (maxMemoryAllocationCount)!");
+	}
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = next;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(device, &allocInfo, hostCallbacks(), &memory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+	liveDeviceAllocations++;
+
+	*mapped = nullptr;
+	if (memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS)
+		{
+			freeDeviceMemory(memory);
+			throw std::runtime_error("failed to map device memory!");
+		}
+	}
+	return memory;
+}
+
+void DeviceAllocator::freeDeviceMemory(VkDeviceMemory memory)
+{
+	// Freeing implicitly unmaps
+	vkFreeMemory(device, memory, hostCallbacks());
+	liveDeviceAllocations--;
+}
+
+std::unique_ptr<DeviceAllocator::Block> DeviceAllocator::createBlock(uint32_t memoryType)
+{
+	auto block = std::make_unique<Block>();
+
+	void* mapped;
+	block->memory = allocateDeviceMemory(memoryType, blockSize, &mapped);
+	block->mapped = static_cast<char*>(mapped);
+
+	block->nodes.assign((size_t(1) << levelCount) - 1, NODE_ABSENT);
+	block->freeLists.resize(levelCount);
+	block->freeCounts.assign(levelCount, 0);
+	pushFree(*block, 0, 0);
+
+	return block;
+}
+
+bool DeviceAllocator::allocateFromBlock(Block& block, uint32_t level, uint32_t& node)
+{
+	// Smallest free node that still fits
+	int from = static_cast<int>(level);
+	while (from >= 0 && block.freeCounts[from] == 0)
+	{
+		from--;
+	}
+	if (from < 0)
+	{
+		return false;
+	}
+
+	std::vector<uint32_t>& list = block.freeLists[from];
+	uint32_t n = list.back();
+	list.pop_back();
+	while (block.nodes[n] != NODE_FREE)
+	{
+		n = list.back();
+		list.pop_back();
+	}
+	block.freeCounts[from]--;
+
+	// Split down to the requested size, keeping the right halves free
+	for (uint32_t l = static_cast<uint32_t>(from); l < level; l++)
+	{
+		block.nodes[n] = NODE_SPLIT;
+		pushFree(block, 2 * n + 2, l + 1);
+		n = 2 * n + 1;
+	}
+
+	block.nodes[n] = NODE_ALLOCATED;
+	node = n;
+	return true;
+}
+
+void DeviceAllocator::freeInBlock(Block& block, uint32_t node, uint32_t level)
+{
+	block.nodes[node] = NODE_ABSENT;
+
+	// Merge with the buddy for as long as it is free too
+	while (level > 0)
+	{
+		uint32_t buddy = (node & 1) ? node + 1 : node - 1;
+		if (block.nodes[buddy] != NODE_FREE)
+		{
+			break;
+		}
+		block.nodes[buddy] = NODE_ABSENT;
+		block.freeCounts[level]--;
+
+		node = (node - 1) / 2;
+		level--;
+	}
+
+	pushFree(block, node, level);
+}
+
+void DeviceAllocator::pushFree(Block& block, uint32_t node, uint32_t level)
+{
+	block.nodes[node] = NODE_FREE;
+	block.freeCounts[level]++;
+
+	std::vector<uint32_t>& list = block.freeLists[level];
+	list.push_back(node);
+
+	// Merges leave stale entries behind; drop them (and duplicates) once they dominate the list
+	if (list.size() > 2 * static_cast<size_t>(block.freeCounts[level]) + 32)
+	{
+		list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t n) { return block.nodes[n] != NODE_FREE; }), list.end());
+		std::sort(list.begin(), list.end());
+		list.erase(std::unique(list.begin(), list.end()), list.end());
+	}
+}
+
+void DeviceAllocator::place(Allocation& allocation, uint32_t blockIndex, uint32_t node, uint32_t level)
+{
+	Block& block = *pools[allocation.pool].blocks[blockIndex];
+	block.allocationCount++;
+	block.usedBytes += allocation.size;
+	block.nodeBytes += blockSize >> level;
+
+	allocation.memory = block.memory;
+	allocation.offset = nodeOffset(node, level);
+	allocation.mapped = block.mapped != nullptr ? block.mapped + allocation.offset : nullptr;
+	allocation.block = blockIndex;
+	allocation.level = level;
+}
+
+VkDeviceSize DeviceAllocator::nodeOffset(uint32_t node, uint32_t level) const
+{
+	return static_cast<VkDeviceSize>(node - ((1u << level) - 1)) * (blockSize >> level);
+}
+
+VkDeviceSize DeviceAllocator::largestFree(const Block& block) const
+{
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		if (block.freeCounts[level] > 0)
+		{
+			return blockSize >> level;
+		}
+	}
+	return 0;
+}
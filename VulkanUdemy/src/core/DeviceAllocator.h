@@ -0,0 +1,152 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Buffers and linear images vs optimal-tiling images; the two never share a
+// bufferImageGranularity page because they are carved from different blocks
+enum class ResourceKind
+{
+	Linear,
+	Optimal
+};
+
+struct Allocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;		// as requested
+	void* mapped = nullptr;		// host-visible memory stays mapped; already offset
+	uint32_t memoryType = 0;
+
+	// Where it came from, for free(); pool == UINT32_MAX means a dedicated allocation
+	uint32_t pool = UINT32_MAX;
+	uint32_t block = 0;
+	uint32_t level = 0;
+};
+
+struct HeapStats
+{
+	uint32_t heapIndex = 0;
+	VkDeviceSize heapSize = 0;
+	uint32_t blockCount = 0;
+	uint32_t dedicatedCount = 0;
+	uint32_t allocationCount = 0;
+	VkDeviceSize reservedBytes = 0;	// vkAllocateMemory'd (blocks + dedicated)
+	VkDeviceSize usedBytes = 0;		// requested by live allocations
+	VkDeviceSize wastedBytes = 0;	// buddy rounding inside live allocations
+	VkDeviceSize largestFree = 0;	// biggest single allocation a block could still take
+	float fragmentation = 0.0f;		// share of free block bytes not in their block's largest hole (0 = one hole per block)
+};
+
+// Sub-allocates device memory from large per-memory-type blocks with a buddy allocator, so
+// resources cost a few list operations instead of a vkAllocateMemory each. Requests larger
+// than half a block get their own vkAllocateMemory; so do images the driver prefers a dedicated
+// allocation for (VkMemoryDedicatedRequirements, on 1.1 devices), made with VkMemoryDedicatedAllocateInfo.
+// Thread safe.
+class DeviceAllocator
+{
+public:
+	void create(VkPhysicalDevice gpu, VkDevice device, VkDeviceSize blockSize = 64ull * 1024 * 1024);
+	void destroy();
+
+	Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceKind kind, bool dedicated = false);
+	void free(const Allocation& allocation);
+
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& allocation);
+	void destroyBuffer(VkBuffer buffer, const Allocation& allocation);
+	void createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, Allocation& allocation);
+	void destroyImage(VkImage image, const Allocation& allocation);
+
+	// Only heaps with something reserved
+	std::vector<HeapStats> getHeapStats() const;
+	void printStats() const;
+
+	// Block-level access for the Defragmenter
+	struct BlockInfo
+	{
+		uint32_t pool;
+		uint32_t block;
+		VkDeviceSize nodeBytes;		// buddy bytes handed out
+		uint32_t allocationCount;
+		bool evacuating;
+	};
+	std::vector<BlockInfo> getBlocks() const;
+	bool hasBlock(uint32_t pool, uint32_t block) const;
+	// Evacuating blocks take no new allocations, so they drain as their contents move or die
+	void setEvacuating(uint32_t pool, uint32_t block, bool evacuating);
+	// Same pool and node size as source, in an existing non-evacuating block (densest first); false if none has room
+	bool allocateMove(const Allocation& source, Allocation& destination);
+
+	uint32_t deviceAllocationCount() const;
+	VkDeviceSize getBlockSize() const { return blockSize; }
+	VkDevice getDevice() const { return device; }
+	VkPhysicalDevice getPhysicalDevice() const { return gpu; }
+
+private:
+	enum NodeState : uint8_t
+	{
+		NODE_ABSENT,	// covered by a free or allocated ancestor
+		NODE_FREE,
+		NODE_SPLIT,
+		NODE_ALLOCATED
+	};
+
+	struct Block
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		char* mapped = nullptr;
+		// Complete binary tree over the block, root = 0, children of i = 2i+1 / 2i+2
+		std::vector<uint8_t> nodes;
+		// Free nodes per level; entries are checked against nodes[] when popped, stale ones are skipped
+		std::vector<std::vector<uint32_t>> freeLists;
+		std::vector<uint32_t> freeCounts;
+		uint32_t allocationCount = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize nodeBytes = 0;
+		bool evacuating = false;
+	};
+
+	struct Pool
+	{
+		uint32_t memoryType = 0;
+		std::vector<std::unique_ptr<Block>> blocks;	// null slots are reused
+	};
+
+	VkPhysicalDevice gpu = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memProperties{};
+	VkDeviceSize blockSize = 0;
+	uint32_t levelCount = 0;
+	bool separateOptimal = false;	// bufferImageGranularity exceeds the smallest node
+	bool dedicatedQueries = false;	// 1.1 device: vkGetImageMemoryRequirements2 and dedicated allocations
+	uint32_t maxDeviceAllocations = 0;
+
+	std::vector<Pool> pools;	// memoryType * 2 + kind
+	struct Dedicated
+	{
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		uint32_t memoryType;
+	};
+	std::vector<Dedicated> dedicated;
+	uint32_t liveDeviceAllocations = 0;
+	mutable std::mutex mutex;
+
+	uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+	// next: chained into VkMemoryAllocateInfo
+	VkDeviceMemory allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, void** mapped, const void* next = nullptr);
+	Allocation allocateForImage(VkImage image, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties);
+	void freeDeviceMemory(VkDeviceMemory memory);
+
+	std::unique_ptr<Block> createBlock(uint32_t memoryType);
+	bool allocateFromBlock(Block& block, uint32_t level, uint32_t& node);
+	void place(Allocation& allocation, uint32_t blockIndex, uint32_t node, uint32_t level);
+	void freeInBlock(Block& block, uint32_t node, uint32_t level);
+	void pushFree(Block& block, uint32_t node, uint32_t level);
+	VkDeviceSize nodeOffset(uint32_t node, uint32_t level) const;
+	VkDeviceSize largestFree(const Block& block) const;
+};
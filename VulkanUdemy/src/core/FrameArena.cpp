@@ -0,0 +1,86 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void FrameArena::create(DeviceAllocator* allocator_, VkDeviceSize bytesPerFrame_, uint32_t framesInFlight_, VkDeviceSize chunkSize_)
+{
+	allocator = allocator_;
+	device = allocator->getDevice();
+	framesInFlight = framesInFlight_;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(allocator->getPhysicalDevice(), &properties);
+	alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+
+	// Chunks and regions start aligned, so every allocation inside them can be
+	chunkSize = alignUp(chunkSize_, alignment);
+	bytesPerFrame = alignUp(std::max(bytesPerFrame_, chunkSize), alignment);
+	if (bytesPerFrame * framesInFlight > UINT32_MAX)
+	{
+		throw std::runtime_error("frame arena does not fit 32-bit dynamic offsets!");
+	}
+
+	allocator->createBuffer(bytesPerFrame * framesInFlight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+	mapped = static_cast<char*>(memory.mapped);
+
+	beginFrame(0);
+}
+
+void FrameArena::destroy()
+{
+	if (buffer != VK_NULL_HANDLE)
+	{
+		allocator->destroyBuffer(buffer, memory);
+		buffer = VK_NULL_HANDLE;
+		mapped = nullptr;
+	}
+}
+
+void FrameArena::beginFrame(uint32_t frameSlot)
+{
+	peakBytes = std::max(peakBytes, std::min(frameUsed.load(std::memory_order_relaxed), bytesPerFrame));
+	frameBase = static_cast<VkDeviceSize>(frameSlot % framesInFlight) * bytesPerFrame;
+	frameUsed.store(0, std::memory_order_relaxed);
+}
+
+VkDeviceSize FrameArena::claim(VkDeviceSize size)
+{
+	VkDeviceSize start = frameUsed.fetch_add(size, std::memory_order_relaxed);
+	if (start + size > bytesPerFrame)
+	{
+		throw std::runtime_error("frame arena is out of memory for this frame!");
+	}
+	return frameBase + start;
+}
+
+void FrameArena::Writer::refill(VkDeviceSize size)
+{
+	// The rest of the old chunk is dropped; larger-than-chunk requests get a chunk of their own
+	VkDeviceSize grab = std::max(size, arena->chunkSize);
+	cursor = arena->claim(grab);
+	end = cursor + grab;
+}
+
+void FrameArena::writeDescriptor(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkDeviceSize range) const
+{
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = range;
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+	write.pBufferInfo = &bufferInfo;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+struct FrameAlloc
+{
+	void* data;
+	uint32_t offset;	// dynamic offset for the arena's UNIFORM_BUFFER_DYNAMIC / STORAGE_BUFFER_DYNAMIC descriptor
+};
+
+// Per-frame constants (per-object matrices, material parameters, ...) bump allocated from one persistently mapped
+// buffer with a region per frame slot. A descriptor written once with writeDescriptor() stays valid; draws pick
+// their data with the dynamic offset. beginFrame() resets a slot's region once its fence has signalled.
+class FrameArena
+{
+public:
+	// A thread's private slice of the current frame's region: allocate() is a pointer bump, and running out only
+	// costs one atomic add on the arena for the next chunk. Don't keep one across beginFrame().
+	class Writer
+	{
+	public:
+		FrameAlloc allocate(VkDeviceSize size)
+		{
+			VkDeviceSize aligned = (size + arena->alignment - 1) & ~(arena->alignment - 1);
+			if (cursor + aligned > end)
+			{
+				refill(aligned);
+			}
+			FrameAlloc alloc{ arena->mapped + cursor, static_cast<uint32_t>(cursor) };
+			cursor += aligned;
+			return alloc;
+		}
+
+		// Copies value in and returns its dynamic offset
+		template<typename T>
+		uint32_t write(const T& value)
+		{
+			FrameAlloc alloc = allocate(sizeof(T));
+			memcpy(alloc.data, &value, sizeof(T));
+			return alloc.offset;
+		}
+
+	private:
+		friend class FrameArena;
+		explicit Writer(FrameArena* arena_) : arena(arena_) {}
+
+		FrameArena* arena;
+		VkDeviceSize cursor = 0;
+		VkDeviceSize end = 0;
+
+		void refill(VkDeviceSize size);
+	};
+
+	void create(DeviceAllocator* allocator, VkDeviceSize bytesPerFrame, uint32_t framesInFlight, VkDeviceSize chunkSize = 16 * 1024);
+	// Call after vkDeviceWaitIdle
+	void destroy();
+
+	// Call once the slot's fence has signalled, before any Writer is made for the frame
+	void beginFrame(uint32_t frameSlot);
+	// Thread safe
+	Writer writer() { return Writer(this); }
+
+	// range = size of the struct one draw reads at its dynamic offset
+	void writeDescriptor(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkDeviceSize range) const;
+
+	VkBuffer getBuffer() const { return buffer; }
+	VkDeviceSize getAlignment() const { return alignment; }
+	VkDeviceSize getBytesPerFrame() const { return bytesPerFrame; }
+	// Most any frame has handed out, chunk tails included
+	VkDeviceSize getPeakBytes() const { return peakBytes; }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceAllocator* allocator = nullptr;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	Allocation memory;
+	char* mapped = nullptr;
+
+	VkDeviceSize alignment = 256;	// max of the uniform and storage offset alignments
+	VkDeviceSize bytesPerFrame = 0;
+	VkDeviceSize chunkSize = 0;
+	uint32_t framesInFlight = 0;
+
+	VkDeviceSize frameBase = 0;
+	std::atomic<VkDeviceSize> frameUsed{ 0 };
+	VkDeviceSize peakBytes = 0;
+
+	// Offset of size fresh bytes in the current frame's region
+	VkDeviceSize claim(VkDeviceSize size);
+};
@@ -0,0 +1,212 @@
+#include "FramePacer.h"
+#include "VulkanDispatch.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+// OS sleeps overshoot by up to a scheduler tick; the last stretch is spent polling fences instead
+static const FramePacer::Clock::duration SPIN_MARGIN = std::chrono::milliseconds(2);
+// Presents that never report (a surface that stopped presenting) are dropped past this many
+static const size_t MAX_PENDING_PRESENTS = 64;
+
+static const char* presentModeName(VkPresentModeKHR mode)
+{
+	switch (mode)
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+	case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+	case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+	default: return "other";
+	}
+}
+
+void FramePacer::create(VkDevice device_, PresentPolicy policy_, uint32_t fpsLimit, uint32_t framesInFlight, bool presentWait_)
+{
+	device = device_;
+	policy = policy_;
+	presentWait = presentWait_;
+	frameInterval = fpsLimit > 0
+		? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fpsLimit))
+		: Clock::duration::zero();
+	nextFrameStart = Clock::now();
+	inFlight.assign(framesInFlight, InFlight{});
+}
+
+VkPresentModeKHR FramePacer::choosePresentMode(const std::vector<VkPresentModeKHR>& available)
+{
+	// FIFO is the only mode every device has to support
+	std::vector<VkPresentModeKHR> preferred;
+	switch (policy)
+	{
+	case PresentPolicy::LowLatency:
+		// MAILBOX doesn't tear and never blocks; without it, FIFO rather than a tearing mode nobody asked for
+		preferred = { VK_PRESENT_MODE_MAILBOX_KHR };
+		break;
+	case PresentPolicy::Immediate:
+		preferred = { VK_PRESENT_MODE_IMMEDIATE_KHR };
+		break;
+	case PresentPolicy::Relaxed:
+		// Tears only when a frame misses its vblank instead of waiting for the next one
+		preferred = { VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+		break;
+	case PresentPolicy::PowerSaving:
+		break;
+	}
+
+	presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	for (VkPresentModeKHR mode : preferred)
+	{
+		if (std::find(available.begin(), available.end(), mode) != available.end())
+		{
+			presentMode = mode;
+			break;
+		}
+	}
+	return presentMode;
+}
+
+void FramePacer::waitForFrameStart()
+{
+	if (frameInterval > Clock::duration::zero())
+	{
+		Clock::time_point now = Clock::now();
+		if (nextFrameStart - now > SPIN_MARGIN)
+		{
+			std::this_thread::sleep_for(nextFrameStart - now - SPIN_MARGIN);
+		}
+		while (Clock::now() < nextFrameStart)
+		{
+			poll();
+			std::this_thread::yield();
+		}
+
+		// After a long frame, start counting again from now rather than rushing to catch up
+		now = Clock::now();
+		nextFrameStart = std::max(nextFrameStart + frameInterval, now);
+	}
+
+	inputTime = Clock::now();
+	inputSampled = true;
+}
+
+void FramePacer::markSubmitted(uint32_t frameSlot, VkFence fence)
+{
+	Clock::time_point now = Clock::now();
+	if (inputSampled)
+	{
+		inputToSubmit.push_back(std::chrono::duration<double, std::milli>(now - inputTime).count());
+		inputSampled = false;
+	}
+	if (presentWait)
+	{
+		lastSubmit = now;
+		return;
+	}
+	inFlight[frameSlot] = { fence, now };
+}
+
+void FramePacer::markCompleted(uint32_t frameSlot)
+{
+	complete(inFlight[frameSlot], Clock::now());
+}
+
+void FramePacer::markPresented(VkSwapchainKHR swapchain, uint64_t presentId)
+{
+	if (!presentWait)
+	{
+		return;
+	}
+	if (presented.size() >= MAX_PENDING_PRESENTS)
+	{
+		presented.pop_front();
+	}
+	presented.push_back({ swapchain, presentId, lastSubmit });
+}
+
+void FramePacer::swapchainChanged()
+{
+	presented.clear();
+}
+
+void FramePacer::poll()
+{
+	if (presentWait)
+	{
+		// Ids complete in order (a replaced MAILBOX frame completes with the one that replaced it), so the first
+		// still pending ends the scan
+		while (!presented.empty())
+		{
+			const Presented& frame = presented.front();
+			VkResult result = vkd().vkWaitForPresentKHR(device, frame.swapchain, frame.presentId, 0);
+			if (result == VK_TIMEOUT)
+			{
+				break;
+			}
+			// Errors (out of date, surface lost) leave no sample
+			if (result == VK_SUCCESS)
+			{
+				submitToPresent.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frame.submitTime).count());
+			}
+			presented.pop_front();
+		}
+		return;
+	}
+
+	for (InFlight& frame : inFlight)
+	{
+		if (frame.fence != VK_NULL_HANDLE && vkd().vkGetFenceStatus(device, frame.fence) == VK_SUCCESS)
+		{
+			complete(frame, Clock::now());
+		}
+	}
+}
+
+void FramePacer::complete(InFlight& frame, Clock::time_point when)
+{
+	if (frame.fence == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	submitToPresent.push_back(std::chrono::duration<double, std::milli>(when - frame.submitTime).count());
+	frame.fence = VK_NULL_HANDLE;
+}
+
+void FramePacer::reset()
+{
+	inputToSubmit.clear();
+	submitToPresent.clear();
+}
+
+LatencyPercentiles FramePacer::percentiles(std::vector<double> samples)
+{
+	LatencyPercentiles result;
+	result.samples = static_cast<uint32_t>(samples.size());
+	if (samples.empty())
+	{
+		return result;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	auto at = [&](double p) { return samples[static_cast<size_t>(p * (samples.size() - 1) + 0.5)]; };
+	result.p50 = at(0.50);
+	result.p90 = at(0.90);
+	result.p99 = at(0.99);
+	result.max = samples.back();
+	return result;
+}
+
+void FramePacer::printStats() const
+{
+	LatencyPercentiles input = getInputToSubmit();
+	LatencyPercentiles present = getSubmitToPresent();
+	if (presentMode != VK_PRESENT_MODE_MAX_ENUM_KHR)
+	{
+		printf("present mode: %s\n", presentModeName(presentMode));
+	}
+	printf("latency (ms):        %8s %8s %8s %8s %8s\n", "p50", "p90", "p99", "max", "frames");
+	printf("  input -> submit    %8.3f %8.3f %8.3f %8.3f %8u\n", input.p50, input.p90, input.p99, input.max, input.samples);
+	printf("  %-18s %8.3f %8.3f %8.3f %8.3f %8u\n", presentWait ? "submit -> present" : "submit -> GPU done",
+		present.p50, present.p90, present.p99, present.max, present.samples);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "AppConfig.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+struct LatencyPercentiles
+{
+	double p50 = 0.0;
+	double p90 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+	uint32_t samples = 0;
+};
+
+// Picks the present mode for a PresentPolicy and keeps the CPU from running ahead: waitForFrameStart() sleeps
+// until the frame-rate cap allows the next frame, so input sampled right after it is as fresh as possible.
+// Also measures, per frame, input -> vkQueueSubmit and vkQueueSubmit -> present: with VK_KHR_present_wait the
+// moment vkWaitForPresentKHR reports the frame's present id done, otherwise only the frame's fence signalling
+// (GPU done; FIFO modes may still hold the image for the next vblank). Both are seen at a poll() or a blocking
+// wait, so the main loop polls around input, after present and while waiting.
+class FramePacer
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// fpsLimit 0 = no cap; presentWait: VK_KHR_present_id and VK_KHR_present_wait are enabled and loaded
+	void create(VkDevice device, PresentPolicy policy, uint32_t fpsLimit, uint32_t framesInFlight, bool presentWait);
+
+	VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& available);
+
+	// Call after the frame slot's fence is free and right before sampling input
+	void waitForFrameStart();
+	void markSubmitted(uint32_t frameSlot, VkFence fence);
+	// A blocking wait on the slot's fence just returned
+	void markCompleted(uint32_t frameSlot);
+	// The last submitted frame was queued for presentation with presentId (present wait only)
+	void markPresented(VkSwapchainKHR swapchain, uint64_t presentId);
+	// Pending present ids belong to the old swapchain
+	void swapchainChanged();
+	// Notes completion of frames presented (or whose fences have signalled) since the last check
+	void poll();
+	bool measuresPresent() const { return presentWait; }
+
+	// Drops the samples collected so far
+	void reset();
+	LatencyPercentiles getInputToSubmit() const { return percentiles(inputToSubmit); }
+	LatencyPercentiles getSubmitToPresent() const { return percentiles(submitToPresent); }
+	void printStats() const;
+
+private:
+	struct InFlight
+	{
+		VkFence fence = VK_NULL_HANDLE;
+		Clock::time_point submitTime;
+	};
+
+	struct Presented
+	{
+		VkSwapchainKHR swapchain;
+		uint64_t presentId;
+		Clock::time_point submitTime;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	PresentPolicy policy = PresentPolicy::LowLatency;
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;	// none chosen yet (headless)
+	Clock::duration frameInterval{};	// zero = no cap
+	Clock::time_point nextFrameStart;
+	Clock::time_point inputTime;
+	bool inputSampled = false;
+	std::vector<InFlight> inFlight;	// per frame slot; fence is null when nothing is pending
+	bool presentWait = false;
+	Clock::time_point lastSubmit;
+	std::deque<Presented> presented;	// in present id order
+
+	std::vector<double> inputToSubmit;	// ms
+	std::vector<double> submitToPresent;
+
+	void complete(InFlight& frame, Clock::time_point when);
+	static LatencyPercentiles percentiles(std::vector<double> samples);
+};
@@ -0,0 +1,57 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void FrameStats::begin()
+{
+	start = Clock::now();
+	fenceWait = {};
+	acquireWait = {};
+	recordTime = {};
+	submitTime = {};
+	frames = 0;
+	lastFrameEnd = start;
+	worstFrame = {};
+	recreates = 0;
+	recreateTime = {};
+	worstRecreate = {};
+}
+
+void FrameStats::addSwapchainRecreate(Clock::duration d)
+{
+	recreates++;
+	recreateTime += d;
+	worstRecreate = std::max(worstRecreate, d);
+}
+
+void FrameStats::endFrame()
+{
+	Clock::time_point now = Clock::now();
+	worstFrame = std::max(worstFrame, now - lastFrameEnd);
+	lastFrameEnd = now;
+	frames++;
+}
+
+void FrameStats::print(uint32_t framesInFlight) const
+{
+	using ms = std::chrono::duration<double, std::milli>;
+
+	double totalMs = ms(Clock::now() - start).count();
+	double fenceMs = ms(fenceWait).count();
+	double acquireMs = ms(acquireWait).count();
+	double perFrame = frames > 0 ? 1.0 / static_cast<double>(frames) : 0.0;
+
+	printf("frames in flight: %u\n", framesInFlight);
+	printf("  frames:          %llu in %.1f ms (%.1f fps)\n", static_cast<unsigned long long>(frames), totalMs, totalMs > 0.0 ? frames * 1000.0 / totalMs : 0.0);
+	printf("  fence wait:      %.3f ms/frame\n", fenceMs * perFrame);
+	printf("  acquire wait:    %.3f ms/frame\n", acquireMs * perFrame);
+	printf("  record:          %.3f ms/frame\n", ms(recordTime).count() * perFrame);
+	printf("  submit+present:  %.3f ms/frame\n", ms(submitTime).count() * perFrame);
+	printf("  cpu blocked:     %.1f%% of wall time\n", totalMs > 0.0 ? (fenceMs + acquireMs) * 100.0 / totalMs : 0.0);
+	printf("  worst frame:     %.3f ms\n", ms(worstFrame).count());
+	if (recreates > 0)
+	{
+		printf("  swapchain:       recreated %u times, %.3f ms avg, %.3f ms worst\n", recreates, ms(recreateTime).count() / recreates, ms(worstRecreate).count());
+	}
+}
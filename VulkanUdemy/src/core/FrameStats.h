@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+// Accumulates frame timings so runs with different frame-in-flight counts can be compared
+class FrameStats
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	void begin();
+	void addFenceWait(Clock::duration d) { fenceWait += d; }
+	void addAcquireWait(Clock::duration d) { acquireWait += d; }
+	void addRecord(Clock::duration d) { recordTime += d; }
+	void addSubmit(Clock::duration d) { submitTime += d; }
+	void addSwapchainRecreate(Clock::duration d);
+	void endFrame();
+
+	uint64_t frameCount() const { return frames; }
+	void print(uint32_t framesInFlight) const;
+
+private:
+	Clock::time_point start;
+	Clock::duration fenceWait{};
+	Clock::duration acquireWait{};
+	Clock::duration recordTime{};		// command buffer recording
+	Clock::duration submitTime{};		// vkQueueSubmit + vkQueuePresentKHR
+	uint64_t frames = 0;
+
+	Clock::time_point lastFrameEnd;
+	Clock::duration worstFrame{};		// longest gap between two endFrame() calls
+	uint32_t recreates = 0;
+	Clock::duration recreateTime{};
+	Clock::duration worstRecreate{};
+};
@@ -0,0 +1,94 @@
+#include "GeometryBuffer.h"
+#include "Defragmenter.h"
+#include "VulkanDispatch.h"
+
+#include <stdexcept>
+
+static const VkBufferUsageFlags VERTEX_USAGE = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+static const VkBufferUsageFlags INDEX_USAGE = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+void GeometryBuffer::create(DeviceAllocator* allocator_, StagingRing* staging_, uint32_t vertexStride_, uint32_t maxVertices_, uint32_t maxIndices_)
+{
+	allocator = allocator_;
+	staging = staging_;
+	device = allocator->getDevice();
+	vertexStride = vertexStride_;
+	maxVertices = maxVertices_;
+	maxIndices = maxIndices_;
+
+	// TRANSFER_SRC so the defragmenter can copy them out
+	allocator->createBuffer(static_cast<VkDeviceSize>(vertexStride) * maxVertices, VERTEX_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexMemory);
+	allocator->createBuffer(static_cast<VkDeviceSize>(sizeof(uint32_t)) * maxIndices, INDEX_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexMemory);
+}
+
+void GeometryBuffer::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	if (defragmenter != nullptr)
+	{
+		defragmenter->remove(&vertexMemory);
+		defragmenter->remove(&indexMemory);
+		defragmenter = nullptr;
+	}
+
+	allocator->destroyBuffer(indexBuffer, indexMemory);
+	allocator->destroyBuffer(vertexBuffer, vertexMemory);
+
+	device = VK_NULL_HANDLE;
+	vertexCount = 0;
+	indexCount = 0;
+}
+
+void GeometryBuffer::makeMovable(Defragmenter* defragmenter_)
+{
+	defragmenter = defragmenter_;
+	defragmenter->addBuffer(&vertexBuffer, &vertexMemory, static_cast<VkDeviceSize>(vertexStride) * maxVertices, VERTEX_USAGE);
+	defragmenter->addBuffer(&indexBuffer, &indexMemory, static_cast<VkDeviceSize>(sizeof(uint32_t)) * maxIndices, INDEX_USAGE);
+}
+
+Mesh GeometryBuffer::upload(const void* vertices, uint32_t newVertexCount, const uint32_t* indices, uint32_t newIndexCount)
+{
+	if (vertexCount + newVertexCount > maxVertices || indexCount + newIndexCount > maxIndices)
+	{
+		throw std::runtime_error("geometry buffer is full!");
+	}
+
+	Mesh mesh;
+	mesh.indexCount = newIndexCount;
+	mesh.firstIndex = indexCount;
+	mesh.vertexOffset = static_cast<int32_t>(vertexCount);
+
+	VkDeviceSize vertexBytes = static_cast<VkDeviceSize>(vertexStride) * newVertexCount;
+	VkDeviceSize indexBytes = static_cast<VkDeviceSize>(sizeof(uint32_t)) * newIndexCount;
+	staging->uploadBuffer(vertexBuffer, static_cast<VkDeviceSize>(vertexStride) * vertexCount, vertices, vertexBytes);
+	staging->uploadBuffer(indexBuffer, static_cast<VkDeviceSize>(sizeof(uint32_t)) * indexCount, indices, indexBytes);
+
+	vertexCount += newVertexCount;
+	indexCount += newIndexCount;
+
+	uploadedBytes += vertexBytes + indexBytes;
+
+	return mesh;
+}
+
+void GeometryBuffer::reset()
+{
+	vertexCount = 0;
+	indexCount = 0;
+}
+
+void GeometryBuffer::bind(VkCommandBuffer commandBuffer) const
+{
+	VkDeviceSize offset = 0;
+	vkd().vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+	vkd().vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void GeometryBuffer::draw(VkCommandBuffer commandBuffer, const Mesh& mesh, uint32_t instanceCount)
+{
+	vkd().vkCmdDrawIndexed(commandBuffer, mesh.indexCount, instanceCount, mesh.firstIndex, mesh.vertexOffset, 0);
+}
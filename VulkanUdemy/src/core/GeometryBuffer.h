@@ -0,0 +1,59 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+#include "StagingRing.h"
+
+class Defragmenter;
+
+// A range of a GeometryBuffer, drawn with vkCmdDrawIndexed
+struct Mesh
+{
+	uint32_t indexCount = 0;
+	uint32_t firstIndex = 0;
+	int32_t vertexOffset = 0;
+};
+
+// DEVICE_LOCAL vertex + index buffers shared by many meshes (one vertex format per buffer).
+// Meshes are appended; data goes through the staging ring.
+class GeometryBuffer
+{
+public:
+	void create(DeviceAllocator* allocator, StagingRing* staging, uint32_t vertexStride, uint32_t maxVertices, uint32_t maxIndices);
+	void destroy();
+
+	// Lets the defragmenter relocate the vertex and index buffers; destroy() unregisters them
+	void makeMovable(Defragmenter* defragmenter);
+
+	// Queues the copies on the staging ring: drawable after the next frame records them (or staging->flush()).
+	// Indices are relative to the mesh's first vertex.
+	Mesh upload(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+	// Forget every mesh; the buffers are reused by the next upload
+	void reset();
+
+	void bind(VkCommandBuffer commandBuffer) const;
+	static void draw(VkCommandBuffer commandBuffer, const Mesh& mesh, uint32_t instanceCount = 1);
+
+	VkDeviceSize bytesUploaded() const { return uploadedBytes; }
+	// Change when the defragmenter moves the buffers; recorded commands that bound them are stale then
+	VkBuffer getVertexBuffer() const { return vertexBuffer; }
+	VkBuffer getIndexBuffer() const { return indexBuffer; }
+
+private:
+	DeviceAllocator* allocator = nullptr;
+	StagingRing* staging = nullptr;
+	Defragmenter* defragmenter = nullptr;
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t vertexStride = 0;
+	uint32_t maxVertices = 0;
+	uint32_t maxIndices = 0;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	Allocation vertexMemory;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	Allocation indexMemory;
+
+	VkDeviceSize uploadedBytes = 0;
+};
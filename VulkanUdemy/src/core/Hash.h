@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// FNV-1a, used for content keys (cache blobs, shader code, pipeline descriptions)
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 1469598103934665603ull)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+template <typename T>
+inline uint64_t hashCombine(uint64_t seed, const T& value)
+{
+	return hashBytes(&value, sizeof(T), seed);
+}
@@ -0,0 +1,346 @@
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static const char* SCOPE_NAMES[] = { "command", "object", "cache", "device", "instance" };
+
+static const size_t HEADER_SPACE = 32;		// in front of every allocation, enough for Header at any alignment
+static const size_t COMMAND_ARENA_SIZE = 256 * 1024;
+static const size_t SLAB_SIZE = 64 * 1024;
+static const size_t SLAB_MIN_CLASS = 64;
+static const size_t PAGE_ALIGNMENT = 4096;	// arena and slab memory; larger alignments go to the general heap
+
+enum Source : uint8_t
+{
+	SOURCE_GENERAL,
+	SOURCE_ARENA,
+	SOURCE_SLAB
+};
+
+struct Header
+{
+	void* owner;		// the CommandArena, for arena allocations
+	uint64_t size;
+	uint32_t offset;	// from the start of the underlying block to the returned pointer
+	uint8_t scope;
+	uint8_t source;
+	uint8_t sizeClass;
+};
+
+// Command-scope allocations are freed before the Vulkan call that made them returns, so each thread
+// bumps its own arena and rewinds it whenever nothing in it is live
+struct CommandArena
+{
+	char* base = nullptr;
+	size_t used = 0;
+	std::atomic<uint32_t> live{ 0 };
+
+	~CommandArena();
+};
+
+static void* alignedAlloc(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	return std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+}
+
+static void alignedFree(void* memory)
+{
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+CommandArena::~CommandArena()
+{
+	alignedFree(base);
+}
+
+static thread_local CommandArena commandArena;
+
+static Header* headerOf(void* memory)
+{
+	return reinterpret_cast<Header*>(static_cast<char*>(memory) - sizeof(Header));
+}
+
+HostAllocator& HostAllocator::get()
+{
+	static HostAllocator instance;
+	return instance;
+}
+
+HostAllocator::HostAllocator()
+{
+	vkCallbacks.pUserData = this;
+	vkCallbacks.pfnAllocation = &HostAllocator::allocation;
+	vkCallbacks.pfnReallocation = &HostAllocator::reallocation;
+	vkCallbacks.pfnFree = &HostAllocator::freeing;
+	vkCallbacks.pfnInternalAllocation = &HostAllocator::internalAllocation;
+	vkCallbacks.pfnInternalFree = &HostAllocator::internalFree;
+}
+
+HostAllocator::~HostAllocator()
+{
+	for (SizeClass& sizeClass : sizeClasses)
+	{
+		for (char* slab : sizeClass.slabs)
+		{
+			alignedFree(slab);
+		}
+	}
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	const size_t offset = std::max(alignment, HEADER_SPACE);
+	const size_t total = offset + size;
+	char* block = nullptr;
+	Header header{};
+
+	if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND && offset <= PAGE_ALIGNMENT)
+	{
+		CommandArena& arena = commandArena;
+		if (arena.base == nullptr)
+		{
+			arena.base = static_cast<char*>(alignedAlloc(COMMAND_ARENA_SIZE, PAGE_ALIGNMENT));
+		}
+		if (arena.live.load(std::memory_order_acquire) == 0)
+		{
+			arena.used = 0;
+		}
+
+		size_t start = (arena.used + offset - 1) & ~(offset - 1);
+		if (arena.base != nullptr && start + total <= COMMAND_ARENA_SIZE)
+		{
+			block = arena.base + start;
+			arena.used = start + total;
+			arena.live.fetch_add(1, std::memory_order_relaxed);
+			header.owner = &arena;
+			header.source = SOURCE_ARENA;
+			arenaAllocations.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	else if (scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT && total <= SLAB_MIN_CLASS << (SLAB_CLASSES - 1))
+	{
+		// Blocks are aligned to their power-of-two class, which is larger than offset
+		uint32_t sizeClass = 0;
+		while ((SLAB_MIN_CLASS << sizeClass) < total)
+		{
+			sizeClass++;
+		}
+		block = static_cast<char*>(allocateSlab(sizeClass));
+		if (block != nullptr)
+		{
+			header.source = SOURCE_SLAB;
+			header.sizeClass = static_cast<uint8_t>(sizeClass);
+			slabAllocations.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if (block == nullptr)
+	{
+		block = static_cast<char*>(alignedAlloc(total, offset));
+		if (block == nullptr)
+		{
+			return nullptr;
+		}
+		header.source = SOURCE_GENERAL;
+		generalAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	header.size = size;
+	header.offset = static_cast<uint32_t>(offset);
+	header.scope = static_cast<uint8_t>(scope);
+	char* memory = block + offset;
+	memcpy(headerOf(memory), &header, sizeof(Header));
+
+	Counters& c = counters[scope];
+	c.allocations.fetch_add(1, std::memory_order_relaxed);
+	c.bytes.fetch_add(size, std::memory_order_relaxed);
+	c.liveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+	return memory;
+}
+
+void* HostAllocator::reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (original == nullptr)
+	{
+		return allocate(size, alignment, scope);
+	}
+	if (size == 0)
+	{
+		free(original);
+		return nullptr;
+	}
+
+	// On failure the original must stay valid
+	void* moved = allocate(size, alignment, scope);
+	if (moved != nullptr)
+	{
+		memcpy(moved, original, std::min<size_t>(size, headerOf(original)->size));
+		free(original);
+	}
+	return moved;
+}
+
+void HostAllocator::free(void* memory)
+{
+	if (memory == nullptr)
+	{
+		return;
+	}
+
+	Header header;
+	memcpy(&header, headerOf(memory), sizeof(Header));
+	counters[header.scope].liveBytes.fetch_sub(static_cast<int64_t>(header.size), std::memory_order_relaxed);
+
+	char* block = static_cast<char*>(memory) - header.offset;
+	switch (header.source)
+	{
+	case SOURCE_ARENA:
+		// The owning thread rewinds once this reaches 0
+		static_cast<CommandArena*>(header.owner)->live.fetch_sub(1, std::memory_order_release);
+		break;
+	case SOURCE_SLAB:
+		freeSlab(header.sizeClass, block);
+		break;
+	default:
+		alignedFree(block);
+		break;
+	}
+}
+
+void* HostAllocator::allocateSlab(uint32_t sizeClass)
+{
+	SizeClass& c = sizeClasses[sizeClass];
+	const size_t blockSize = SLAB_MIN_CLASS << sizeClass;
+
+	std::lock_guard<std::mutex> lock(c.mutex);
+	if (c.freeList == nullptr)
+	{
+		char* slab = static_cast<char*>(alignedAlloc(SLAB_SIZE, PAGE_ALIGNMENT));
+		if (slab == nullptr)
+		{
+			return nullptr;
+		}
+		c.slabs.push_back(slab);
+		for (size_t offset = SLAB_SIZE; offset >= blockSize; offset -= blockSize)
+		{
+			char* block = slab + offset - blockSize;
+			*reinterpret_cast<void**>(block) = c.freeList;
+			c.freeList = block;
+		}
+	}
+
+	void* block = c.freeList;
+	c.freeList = *static_cast<void**>(block);
+	return block;
+}
+
+void HostAllocator::freeSlab(uint32_t sizeClass, void* block)
+{
+	SizeClass& c = sizeClasses[sizeClass];
+	std::lock_guard<std::mutex> lock(c.mutex);
+	*static_cast<void**>(block) = c.freeList;
+	c.freeList = block;
+}
+
+void HostAllocator::beginFrames()
+{
+	for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++)
+	{
+		FrameTotals& t = totals[scope];
+		t = FrameTotals{};
+		t.startupAllocations = t.lastAllocations = counters[scope].allocations.load(std::memory_order_relaxed);
+		t.startupBytes = t.lastBytes = counters[scope].bytes.load(std::memory_order_relaxed);
+	}
+	frames = 0;
+}
+
+void HostAllocator::endFrame()
+{
+	for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++)
+	{
+		FrameTotals& t = totals[scope];
+		uint64_t allocations = counters[scope].allocations.load(std::memory_order_relaxed);
+		uint64_t bytes = counters[scope].bytes.load(std::memory_order_relaxed);
+		t.allocations += allocations - t.lastAllocations;
+		t.bytes += bytes - t.lastBytes;
+		t.maxAllocations = std::max(t.maxAllocations, allocations - t.lastAllocations);
+		t.lastAllocations = allocations;
+		t.lastBytes = bytes;
+	}
+	frames++;
+}
+
+void HostAllocator::printStats() const
+{
+	if (!enabled)
+	{
+		printf("host allocations: driver default allocator (--no-host-allocator)\n");
+		return;
+	}
+
+	printf("host allocations over %llu frames:\n", static_cast<unsigned long long>(frames));
+	printf("  %-9s %15s %11s %13s %10s %17s %9s\n", "scope", "startup allocs", "startup KB", "allocs/frame", "KB/frame", "max allocs/frame", "live KB");
+	uint64_t internalAllocations = 0;
+	uint64_t internalBytes = 0;
+	int64_t internalLiveBytes = 0;
+	for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++)
+	{
+		const FrameTotals& t = totals[scope];
+		double perFrame = frames > 0 ? 1.0 / frames : 0.0;
+		printf("  %-9s %15llu %11.1f %13.1f %10.2f %17llu %9.1f\n", SCOPE_NAMES[scope],
+			static_cast<unsigned long long>(t.startupAllocations), t.startupBytes / 1024.0,
+			t.allocations * perFrame, t.bytes * perFrame / 1024.0, static_cast<unsigned long long>(t.maxAllocations),
+			counters[scope].liveBytes.load(std::memory_order_relaxed) / 1024.0);
+		internalAllocations += counters[scope].internalAllocations.load(std::memory_order_relaxed);
+		internalBytes += counters[scope].internalBytes.load(std::memory_order_relaxed);
+		internalLiveBytes += counters[scope].internalLiveBytes.load(std::memory_order_relaxed);
+	}
+	printf("  served by command arenas %llu, object slabs %llu, general heap %llu\n",
+		static_cast<unsigned long long>(arenaAllocations.load()), static_cast<unsigned long long>(slabAllocations.load()),
+		static_cast<unsigned long long>(generalAllocations.load()));
+	printf("  driver-internal: %llu allocations, %.1f KB, %.1f KB live\n", static_cast<unsigned long long>(internalAllocations),
+		internalBytes / 1024.0, internalLiveBytes / 1024.0);
+}
+
+void* VKAPI_CALL HostAllocator::allocation(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<HostAllocator*>(userData)->allocate(size, alignment, scope);
+}
+
+void* VKAPI_CALL HostAllocator::reallocation(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<HostAllocator*>(userData)->reallocate(original, size, alignment, scope);
+}
+
+void VKAPI_CALL HostAllocator::freeing(void* userData, void* memory)
+{
+	static_cast<HostAllocator*>(userData)->free(memory);
+}
+
+void VKAPI_CALL HostAllocator::internalAllocation(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	Counters& c = static_cast<HostAllocator*>(userData)->counters[scope];
+	c.internalAllocations.fetch_add(1, std::memory_order_relaxed);
+	c.internalBytes.fetch_add(size, std::memory_order_relaxed);
+	c.internalLiveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+void VKAPI_CALL HostAllocator::internalFree(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	static_cast<HostAllocator*>(userData)->counters[scope].internalLiveBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// VkAllocationCallbacks for every vkCreate*/vkDestroy* and vkAllocateMemory/vkFreeMemory, so the driver's host
+// allocations are counted per scope and kept off the global heap where that is cheap:
+//  - COMMAND scope (freed before the call returns) bumps a per-thread arena that rewinds when it empties
+//  - OBJECT scope up to 4 KB comes from size-class slabs
+//  - CACHE, DEVICE and INSTANCE scope, and anything bigger, go to the general aligned heap
+// Choose enabled before the first Vulkan call; objects must be destroyed with the callbacks they were created with.
+class HostAllocator
+{
+public:
+	static HostAllocator& get();
+
+	void setEnabled(bool enabled_) { enabled = enabled_; }
+	// nullptr when disabled, so the driver's own allocator is used
+	const VkAllocationCallbacks* callbacks() const { return enabled ? &vkCallbacks : nullptr; }
+
+	// Counts up to now are startup; later ones are split into frames by endFrame()
+	void beginFrames();
+	void endFrame();
+	void printStats() const;
+
+	~HostAllocator();
+
+private:
+	static const uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+	static const uint32_t SLAB_CLASSES = 7;	// 64 B .. 4 KB
+
+	struct Counters
+	{
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+		std::atomic<int64_t> liveBytes{ 0 };
+		// Driver allocations made without the callbacks (executable memory), reported through notifications
+		std::atomic<uint64_t> internalAllocations{ 0 };
+		std::atomic<uint64_t> internalBytes{ 0 };
+		std::atomic<int64_t> internalLiveBytes{ 0 };
+	};
+
+	struct FrameTotals
+	{
+		uint64_t startupAllocations = 0;
+		uint64_t startupBytes = 0;
+		uint64_t allocations = 0;	// over the counted frames
+		uint64_t bytes = 0;
+		uint64_t maxAllocations = 0;	// in a single frame
+		uint64_t lastAllocations = 0;	// counters at the previous endFrame()
+		uint64_t lastBytes = 0;
+	};
+
+	struct SizeClass
+	{
+		std::mutex mutex;
+		void* freeList = nullptr;	// next pointer lives in the free block
+		std::vector<char*> slabs;
+	};
+
+	VkAllocationCallbacks vkCallbacks{};
+	bool enabled = true;
+
+	Counters counters[SCOPE_COUNT];
+	FrameTotals totals[SCOPE_COUNT];
+	uint64_t frames = 0;
+	std::atomic<uint64_t> arenaAllocations{ 0 };
+	std::atomic<uint64_t> slabAllocations{ 0 };
+	std::atomic<uint64_t> generalAllocations{ 0 };
+
+	SizeClass sizeClasses[SLAB_CLASSES];
+
+	HostAllocator();
+
+	void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void free(void* memory);
+
+	void* allocateSlab(uint32_t sizeClass);
+	void freeSlab(uint32_t sizeClass, void* block);
+
+	static void* VKAPI_CALL allocation(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void* VKAPI_CALL reallocation(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void VKAPI_CALL freeing(void* userData, void* memory);
+	static void VKAPI_CALL internalAllocation(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static void VKAPI_CALL internalFree(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+};
+
+inline const VkAllocationCallbacks* hostCallbacks()
+{
+	return HostAllocator::get().callbacks();
+}
@@ -0,0 +1,406 @@
+#include "JobSystem.h"
+
+#include <chrono>
+
+namespace
+{
+	struct WorkerIdentity
+	{
+		const JobSystem* system = nullptr;
+		uint32_t index = UINT32_MAX;
+	};
+
+	thread_local WorkerIdentity identity;
+
+	void deleteJobs(Job* job)
+	{
+		while (job != nullptr)
+		{
+			Job* next = job->next;
+			delete job;
+			job = next;
+		}
+	}
+}
+
+// Finished jobs go back to the thread that allocated them, so a thread that only spawns reuses the jobs others
+// ran instead of calling new while the runners' lists grow. Other threads push onto a lock-free stack that only
+// the owner empties (all at once, so there is no ABA). The pool lives on the heap until both its thread has
+// exited and every job it handed out has come back.
+struct JobPool
+{
+	std::vector<Job*> jobs;	// owner only
+	std::atomic<Job*> returned{ nullptr };
+	std::atomic<uint32_t> references{ 1 };	// the owner thread plus each job out of the pool
+
+	void release()
+	{
+		if (references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			deleteJobs(returned.exchange(nullptr, std::memory_order_acquire));
+			delete this;
+		}
+	}
+};
+
+namespace
+{
+	struct LocalJobCache
+	{
+		JobPool* pool = new JobPool();
+
+		~LocalJobCache()
+		{
+			for (Job* job : pool->jobs)
+			{
+				delete job;
+			}
+			pool->jobs.clear();
+			deleteJobs(pool->returned.exchange(nullptr, std::memory_order_acquire));
+			pool->release();
+		}
+	};
+
+	thread_local LocalJobCache localJobCache;
+}
+
+bool JobSystem::Deque::push(Job* job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= static_cast<int64_t>(DEQUE_SIZE))
+	{
+		return false;
+	}
+	jobs[b & (DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+	// Publishes the job to thieves, which load bottom with acquire
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+Job* JobSystem::Deque::pop()
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// Empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = jobs[b & (DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// Last one: race the thieves for it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			job = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* JobSystem::Deque::steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+	{
+		return nullptr;
+	}
+
+	Job* job = jobs[t & (DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return nullptr;
+	}
+	return job;
+}
+
+void JobSystem::start(uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+	}
+
+	stopping = false;
+	ownerThread = std::this_thread::get_id();
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		deques.push_back(new Deque());
+	}
+	for (uint32_t i = 1; i < threadCount; i++)
+	{
+		workers.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+void JobSystem::stop()
+{
+	if (deques.empty())
+	{
+		return;
+	}
+
+	stopping = true;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+
+	for (Deque* deque : deques)
+	{
+		delete deque;
+	}
+	deques.clear();
+}
+
+uint32_t JobSystem::workerIndex() const
+{
+	if (identity.system == this)
+	{
+		return identity.index;
+	}
+	return std::this_thread::get_id() == ownerThread ? 0 : UINT32_MAX;
+}
+
+Job* JobSystem::allocateJob()
+{
+	JobPool* pool = localJobCache.pool;
+	if (pool->jobs.empty())
+	{
+		for (Job* job = pool->returned.exchange(nullptr, std::memory_order_acquire); job != nullptr; job = job->next)
+		{
+			pool->jobs.push_back(job);
+		}
+	}
+	pool->references.fetch_add(1, std::memory_order_relaxed);
+	if (pool->jobs.empty())
+	{
+		Job* job = new Job();
+		job->pool = pool;
+		return job;
+	}
+	Job* job = pool->jobs.back();
+	pool->jobs.pop_back();
+	return job;
+}
+
+void JobSystem::freeJob(Job* job)
+{
+	JobPool* pool = job->pool;
+	if (pool == localJobCache.pool)
+	{
+		pool->jobs.push_back(job);
+	}
+	else
+	{
+		Job* head = pool->returned.load(std::memory_order_relaxed);
+		do
+		{
+			job->next = head;
+		} while (!pool->returned.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+	}
+	pool->release();
+}
+
+void JobSystem::submit(Job* job)
+{
+	if (job->counter != nullptr)
+	{
+		job->counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	push(job);
+}
+
+void JobSystem::submitAfter(JobCounter& dependency, Job* job)
+{
+	if (job->counter != nullptr)
+	{
+		job->counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (!dependency.done())
+		{
+			job->next = dependency.dependents;
+			dependency.dependents = job;
+			return;
+		}
+	}
+	push(job);
+}
+
+void JobSystem::push(Job* job)
+{
+	uint32_t worker = workerIndex();
+	if (worker != UINT32_MAX)
+	{
+		if (!deques[worker]->push(job))
+		{
+			execute(job);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(injectMutex);
+		injected.push_back(job);
+		injectedCount.fetch_add(1, std::memory_order_release);
+	}
+
+	if (sleeping.load(std::memory_order_relaxed) > 0)
+	{
+		wake.notify_one();
+	}
+}
+
+void JobSystem::execute(Job* job)
+{
+	job->invoke(*job);
+	job->destroy(*job);
+	JobCounter* counter = job->counter;
+	freeJob(job);
+	if (counter != nullptr)
+	{
+		finish(*counter);
+	}
+}
+
+void JobSystem::finish(JobCounter& counter)
+{
+	int32_t pending = counter.pending.load(std::memory_order_relaxed);
+	while (pending > 1)
+	{
+		if (counter.pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+		{
+			return;
+		}
+	}
+
+	// Probably the last one: reach zero under the lock, so wait() can't return (and the counter go away)
+	// while this thread still uses it
+	Job* ready = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(counter.mutex);
+		if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			ready = counter.dependents;
+			counter.dependents = nullptr;
+		}
+	}
+	while (ready != nullptr)
+	{
+		Job* next = ready->next;
+		push(ready);
+		ready = next;
+	}
+}
+
+Job* JobSystem::findJob(uint32_t worker)
+{
+	if (worker != UINT32_MAX)
+	{
+		if (Job* job = deques[worker]->pop())
+		{
+			return job;
+		}
+	}
+
+	if (injectedCount.load(std::memory_order_acquire) > 0)
+	{
+		std::lock_guard<std::mutex> lock(injectMutex);
+		if (!injected.empty())
+		{
+			Job* job = injected.back();
+			injected.pop_back();
+			injectedCount.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	uint32_t count = static_cast<uint32_t>(deques.size());
+	uint32_t first = worker != UINT32_MAX ? worker : 0;
+	for (uint32_t i = 1; i <= count; i++)
+	{
+		if (Job* job = deques[(first + i) % count]->steal())
+		{
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	uint32_t worker = workerIndex();
+	while (!counter.done())
+	{
+		if (Job* job = findJob(worker))
+		{
+			execute(job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// The job that brought it to zero may still hold the lock
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+bool JobSystem::runPending()
+{
+	Job* job = findJob(workerIndex());
+	if (job == nullptr)
+	{
+		return false;
+	}
+	execute(job);
+	return true;
+}
+
+void JobSystem::workerLoop(uint32_t worker)
+{
+	identity.system = this;
+	identity.index = worker;
+
+	uint32_t idleSpins = 0;
+	while (!stopping.load(std::memory_order_relaxed))
+	{
+		if (Job* job = findJob(worker))
+		{
+			execute(job);
+			idleSpins = 0;
+			continue;
+		}
+		if (++idleSpins < 64)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// A wakeup can slip in between the last look and the wait; the timeout bounds what that costs
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleeping.fetch_add(1, std::memory_order_relaxed);
+		wake.wait_for(lock, std::chrono::milliseconds(1));
+		sleeping.fetch_sub(1, std::memory_order_relaxed);
+		idleSpins = 0;
+	}
+
+	identity = WorkerIdentity{};
+}
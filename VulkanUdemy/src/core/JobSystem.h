@@ -0,0 +1,165 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct Job;
+struct JobPool;
+
+// Counts unfinished jobs. JobSystem::wait() runs other jobs until it reaches zero, and jobs spawned with
+// spawnAfter() start once it does. Reusable, and safe to destroy, once wait() has returned on it.
+class JobCounter
+{
+public:
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int32_t> pending{ 0 };
+	std::mutex mutex;
+	Job* dependents = nullptr;	// held back until pending reaches zero
+};
+
+// A job and its callable, stored inline when it fits. Recycled through the pool of the thread that allocated it.
+struct Job
+{
+	static const size_t INLINE_SIZE = 48;
+
+	void (*invoke)(Job& job) = nullptr;
+	void (*destroy)(Job& job) = nullptr;
+	JobCounter* counter = nullptr;
+	JobPool* pool = nullptr;
+	Job* next = nullptr;	// return stack / dependents list
+	alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+};
+
+// Work-stealing scheduler. Every worker owns a Chase-Lev deque: it pushes and pops its own jobs at the bottom
+// (LIFO, cache-warm) without locks, and idle workers steal from the top of the others (FIFO, the oldest and
+// usually biggest pieces). The thread that calls start() is worker 0: it runs jobs whenever it waits. Threads
+// that are not workers can spawn too; their jobs go through a locked injection queue.
+class JobSystem
+{
+public:
+	static const uint32_t DEQUE_SIZE = 4096;	// per worker; a full deque runs the job inline instead
+
+	// threadCount includes the calling thread; 0 = one per core
+	void start(uint32_t threadCount = 0);
+	void stop();
+
+	template <typename F>
+	void spawn(F&& function, JobCounter* counter = nullptr)
+	{
+		submit(makeJob(std::forward<F>(function), counter));
+	}
+
+	// Runs function after every job counted by dependency has finished
+	template <typename F>
+	void spawnAfter(JobCounter& dependency, F&& function, JobCounter* counter = nullptr)
+	{
+		submitAfter(dependency, makeJob(std::forward<F>(function), counter));
+	}
+
+	// Runs other jobs until counter reaches zero
+	void wait(JobCounter& counter);
+	// Runs one waiting job on this thread, if there is one; for callers that wait on something else as well
+	bool runPending();
+
+	// function(first, last) over [begin, end), split in halves until a range is at most grain long; the halves
+	// are what idle workers steal
+	template <typename F>
+	void parallelFor(uint32_t begin, uint32_t end, uint32_t grain, const F& function)
+	{
+		JobCounter counter;
+		splitRange(begin, end, grain > 0 ? grain : 1, function, counter);
+		wait(counter);
+	}
+
+	uint32_t threadCount() const { return static_cast<uint32_t>(deques.size()); }
+	// This thread's worker index, or UINT32_MAX if it is not one of this system's workers
+	uint32_t workerIndex() const;
+
+	~JobSystem() { stop(); }
+
+private:
+	// Chase-Lev deque (Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models")
+	class Deque
+	{
+	public:
+		bool push(Job* job);
+		Job* pop();
+		Job* steal();
+
+	private:
+		alignas(64) std::atomic<int64_t> top{ 0 };
+		alignas(64) std::atomic<int64_t> bottom{ 0 };
+		std::atomic<Job*> jobs[DEQUE_SIZE];
+	};
+
+	std::vector<Deque*> deques;
+	std::vector<std::thread> workers;
+	std::thread::id ownerThread;
+	std::atomic<bool> stopping{ false };
+
+	std::mutex injectMutex;
+	std::vector<Job*> injected;
+	std::atomic<uint32_t> injectedCount{ 0 };
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<uint32_t> sleeping{ 0 };
+
+	template <typename F>
+	static Job* makeJob(F&& function, JobCounter* counter)
+	{
+		typedef typename std::decay<F>::type Function;
+		Job* job = allocateJob();
+		job->counter = counter;
+		if constexpr (sizeof(Function) <= Job::INLINE_SIZE && alignof(Function) <= alignof(std::max_align_t))
+		{
+			new (job->storage) Function(std::forward<F>(function));
+			job->invoke = [](Job& j) { (*reinterpret_cast<Function*>(j.storage))(); };
+			job->destroy = [](Job& j) { reinterpret_cast<Function*>(j.storage)->~Function(); };
+		}
+		else
+		{
+			*reinterpret_cast<Function**>(job->storage) = new Function(std::forward<F>(function));
+			job->invoke = [](Job& j) { (**reinterpret_cast<Function**>(j.storage))(); };
+			job->destroy = [](Job& j) { delete *reinterpret_cast<Function**>(j.storage); };
+		}
+		return job;
+	}
+
+	template <typename F>
+	void splitRange(uint32_t begin, uint32_t end, uint32_t grain, const F& function, JobCounter& counter)
+	{
+		if (end - begin <= grain)
+		{
+			function(begin, end);
+			return;
+		}
+		uint32_t middle = begin + (end - begin) / 2;
+		spawn([this, middle, end, grain, &function, &counter] { splitRange(middle, end, grain, function, counter); }, &counter);
+		splitRange(begin, middle, grain, function, counter);
+	}
+
+	static Job* allocateJob();
+	static void freeJob(Job* job);
+
+	void submit(Job* job);
+	void submitAfter(JobCounter& dependency, Job* job);
+	// Onto this worker's deque, or the injection queue from other threads; counters were already bumped
+	void push(Job* job);
+	void execute(Job* job);
+	void finish(JobCounter& counter);
+	// Own deque, then the injection queue, then the other workers' deques
+	Job* findJob(uint32_t worker);
+	void workerLoop(uint32_t worker);
+};
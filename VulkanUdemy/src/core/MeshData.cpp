@@ -0,0 +1,51 @@
+#include "MeshData.h"
+
+#include <cmath>
+
+MeshData makeTriangleMesh()
+{
+	MeshData mesh;
+	mesh.vertices = {
+		{ { 0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+		{ { 0.5f, 0.5f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } }
+	};
+	mesh.indices = { 0, 1, 2 };
+	return mesh;
+}
+
+MeshData makeGridMesh(uint32_t triangleCount)
+{
+	uint32_t quads = (triangleCount + 1) / 2;
+	uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(quads))));
+	uint32_t rows = (quads + columns - 1) / columns;
+
+	MeshData mesh;
+	mesh.vertices.reserve(static_cast<size_t>(columns + 1) * (rows + 1));
+	mesh.indices.reserve(static_cast<size_t>(quads) * 6);
+
+	for (uint32_t y = 0; y <= rows; y++)
+	{
+		for (uint32_t x = 0; x <= columns; x++)
+		{
+			float u = static_cast<float>(x) / columns;
+			float v = static_cast<float>(y) / rows;
+			mesh.vertices.push_back({ { -0.9f + 1.8f * u, -0.9f + 1.8f * v }, { u, v, 1.0f - u } });
+		}
+	}
+
+	// Same winding as the triangle (clockwise in screen space) so back-face culling keeps them
+	uint32_t stride = columns + 1;
+	for (uint32_t q = 0; q < quads; q++)
+	{
+		uint32_t x = q % columns;
+		uint32_t y = q / columns;
+		uint32_t i0 = y * stride + x;
+		uint32_t i1 = i0 + 1;
+		uint32_t i2 = i0 + stride;
+		uint32_t i3 = i2 + 1;
+		mesh.indices.insert(mesh.indices.end(), { i0, i1, i3, i0, i3, i2 });
+	}
+
+	return mesh;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Matches the inputs of vert_mesh.glsl (packed: vec2 position, vec3 color)
+struct MeshVertex
+{
+	float pos[2];
+	float color[3];
+};
+
+struct MeshData
+{
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+
+	uint32_t triangleCount() const { return static_cast<uint32_t>(indices.size() / 3); }
+};
+
+MeshData makeTriangleMesh();
+// Regular grid of roughly square quads covering most of clip space with exactly triangleCount triangles (rounded up to even)
+MeshData makeGridMesh(uint32_t triangleCount);
@@ -0,0 +1,29 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+
+#include <vector>
+
+// Device-owned color images that stand in for swapchain images when running without a window
+class OffscreenTarget
+{
+public:
+	void create(DeviceAllocator* allocator, VkExtent2D extent, VkFormat format, uint32_t imageCount);
+	void destroy();
+
+	VkFormat getFormat() const { return format; }
+	VkExtent2D getExtent() const { return extent; }
+	const std::vector<VkImage>& getImages() const { return images; }
+	const std::vector<VkImageView>& getImageViews() const { return imageViews; }
+
+private:
+	DeviceAllocator* allocator = nullptr;
+	VkDevice device = VK_NULL_HANDLE;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = { 0, 0 };
+
+	std::vector<VkImage> images;
+	std::vector<Allocation> allocations;
+	std::vector<VkImageView> imageViews;
+};
@@ -0,0 +1,134 @@
+#include "ParallelRecorder.h"
+#include "HostAllocator.h"
+#include "VulkanDispatch.h"
+
+#include <stdexcept>
+
+void ParallelRecorder::create(VkDevice device_, uint32_t queueFamily, uint32_t threadCount, uint32_t framesInFlight)
+{
+	device = device_;
+	threads = threadCount > 0 ? threadCount : 1;
+	pools.resize(static_cast<size_t>(threads) * framesInFlight);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;	// whole pools are reset, never single buffers
+	poolInfo.queueFamilyIndex = queueFamily;
+	for (WorkerPool& p : pools)
+	{
+		if (vkCreateCommandPool(device, &poolInfo, hostCallbacks(), &p.pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create recording command pool!");
+		}
+	}
+
+	jobs.start(threads);
+}
+
+void ParallelRecorder::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	jobs.stop();
+	for (WorkerPool& p : pools)
+	{
+		vkDestroyCommandPool(device, p.pool, hostCallbacks());
+	}
+	pools.clear();
+	device = VK_NULL_HANDLE;
+}
+
+void ParallelRecorder::beginFrame(uint32_t frameSlot)
+{
+	currentSlot = frameSlot;
+	for (uint32_t t = 0; t < threads; t++)
+	{
+		WorkerPool& p = pools[currentSlot * threads + t];
+		if (p.used > 0)
+		{
+			vkd().vkResetCommandPool(device, p.pool, 0);
+			p.used = 0;
+		}
+	}
+}
+
+const std::vector<VkCommandBuffer>& ParallelRecorder::record(const VkCommandBufferInheritanceInfo& inheritance, uint32_t drawCount,
+	const RecordRange& recordRange)
+{
+	// Every range is recorded into the pool of the worker that runs it; any other thread has no pool
+	if (jobs.workerIndex() == UINT32_MAX)
+	{
+		throw std::runtime_error("ParallelRecorder::record called off the thread that created it!");
+	}
+
+	// Contiguous ranges keep the draws in order across the secondaries; a few per thread so a slow one
+	// can be balanced by stealing
+	uint32_t ranges = threads == 1 ? 1 : threads * 4;
+	ranges = drawCount < ranges ? drawCount : ranges;
+	recorded.assign(ranges, VK_NULL_HANDLE);
+	jobs.parallelFor(0, ranges, 1, [&](uint32_t firstRange, uint32_t endRange) {
+		for (uint32_t r = firstRange; r < endRange; r++)
+		{
+			uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * r / ranges);
+			uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * (r + 1) / ranges);
+			try
+			{
+				recorded[r] = recordOn(jobs.workerIndex(), inheritance, first, end - first, recordRange);
+			}
+			catch (const std::exception& e)
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				error = e.what();
+			}
+		}
+	});
+
+	if (!error.empty())
+	{
+		std::string message = error;
+		error.clear();
+		throw std::runtime_error(message);
+	}
+	return recorded;
+}
+
+VkCommandBuffer ParallelRecorder::recordOn(uint32_t worker, const VkCommandBufferInheritanceInfo& inheritance, uint32_t first, uint32_t count,
+	const RecordRange& recordRange)
+{
+	WorkerPool& p = pools[currentSlot * threads + worker];
+	if (p.used == p.buffers.size())
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = p.pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+		VkCommandBuffer buffer;
+		if (vkAllocateCommandBuffers(device, &allocInfo, &buffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate secondary command buffer!");
+		}
+		p.buffers.push_back(buffer);
+	}
+	VkCommandBuffer commandBuffer = p.buffers[p.used++];
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+	if (vkd().vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to begin recording secondary command buffer!");
+	}
+
+	recordRange(commandBuffer, first, count);
+
+	if (vkd().vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to record secondary command buffer!");
+	}
+	return commandBuffer;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "JobSystem.h"
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records the draws of a render pass on several threads. Each JobSystem worker has its own VkCommandPool per frame
+// in flight (pools are externally synchronized, so threads never share one). The draws are cut into contiguous
+// ranges, each recorded into a secondary command buffer by whichever worker runs or steals it; the primary runs
+// them with vkCmdExecuteCommands in draw order. The thread that calls create() is worker 0 and records while it
+// waits, so threadCount 1 is plain single-threaded recording; record() must be called on that thread.
+class ParallelRecorder
+{
+public:
+	// Records draws [first, first + count) into a secondary that is already begun; runs on any thread
+	typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)> RecordRange;
+
+	void create(VkDevice device, uint32_t queueFamily, uint32_t threadCount, uint32_t framesInFlight);
+	void destroy();
+
+	// Call once the slot's fence has signalled: recycles every secondary recorded for it
+	void beginFrame(uint32_t frameSlot);
+	// Secondaries for the subpass in inheritance, ready for vkCmdExecuteCommands (the render pass must have been
+	// begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS). The list is reused by the next record().
+	// Only on the thread that called create(); throws on any other.
+	const std::vector<VkCommandBuffer>& record(const VkCommandBufferInheritanceInfo& inheritance, uint32_t drawCount, const RecordRange& recordRange);
+
+	uint32_t threadCount() const { return threads; }
+
+private:
+	struct WorkerPool
+	{
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> buffers;	// allocated on demand, reused after each pool reset
+		uint32_t used = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t threads = 0;
+	uint32_t currentSlot = 0;
+	std::vector<WorkerPool> pools;	// [frameSlot * threads + worker]
+	JobSystem jobs;
+	std::vector<VkCommandBuffer> recorded;
+
+	std::mutex errorMutex;
+	std::string error;
+
+	VkCommandBuffer recordOn(uint32_t worker, const VkCommandBufferInheritanceInfo& inheritance, uint32_t first, uint32_t count,
+		const RecordRange& recordRange);
+};
@@ -0,0 +1,7 @@
+#pragma once
+#include "PipelineDesc.h"
+#include "ShaderModuleCache.h"
+
+// Creates the pipeline described by desc against cache, taking shader modules from modules.
+// Safe to call from several threads at once.
+VkPipeline buildGraphicsPipeline(VkDevice device, VkPipelineCache cache, const PipelineDesc& desc, VkPipelineLayout layout, ShaderModuleCache& modules);
@@ -0,0 +1,171 @@
+#include "PipelineCache.h"
+#include "Hash.h"
+#include "HostAllocator.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+static const uint32_t PIPELINE_CACHE_MAGIC = 0x31435056; // "VPC1"
+static const uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+void PipelineCache::create(VkPhysicalDevice gpu, VkDevice device_, const std::string& path_)
+{
+	device = device_;
+	path = path_;
+	vkGetPhysicalDeviceProperties(gpu, &props);
+
+	std::string data;
+	if (!path.empty())
+	{
+		std::ifstream file(path, std::ios::binary);
+		FileHeader header{};
+
+		if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) && header.dataSize < (1ull << 32))
+		{
+			data.resize(static_cast<size_t>(header.dataSize));
+			if (!file.read(data.data(), data.size()) || !isCompatible(header, data))
+			{
+				data.clear();
+			}
+		}
+	}
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(device, &createInfo, hostCallbacks(), &cache) != VK_SUCCESS)
+	{
+		// A driver may still reject a blob we thought was valid; fall back to a cold cache
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+		data.clear();
+
+		if (vkCreatePipelineCache(device, &createInfo, hostCallbacks(), &cache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+	}
+
+	warm = !data.empty();
+	loadedBytes = data.size();
+	lastSavedSize = data.size();
+}
+
+void PipelineCache::destroy()
+{
+	vkDestroyPipelineCache(device, cache, hostCallbacks());
+	cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::save()
+{
+	if (path.empty() || cache == VK_NULL_HANDLE)
+	{
+		return false;
+	}
+
+	size_t size = 0;
+	if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS)
+	{
+		return false;
+	}
+	data.resize(size);
+
+	FileHeader header{};
+	header.magic = PIPELINE_CACHE_MAGIC;
+	header.version = PIPELINE_CACHE_FILE_VERSION;
+	header.vendorID = props.vendorID;
+	header.deviceID = props.deviceID;
+	header.driverVersion = props.driverVersion;
+	std::memcpy(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.dataHash = hashBytes(data.data(), data.size());
+
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		file.flush();
+
+		if (!file)
+		{
+			file.close();
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec)
+	{
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+	lastSavedSize = data.size();
+	return true;
+}
+
+void PipelineCache::checkpoint(uint64_t frameIndex, uint32_t checkpointInterval)
+{
+	if (checkpointInterval == 0 || frameIndex == 0 || frameIndex % checkpointInterval != 0)
+	{
+		return;
+	}
+
+	// Nothing new was compiled since the last write
+	size_t size = 0;
+	if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == lastSavedSize)
+	{
+		return;
+	}
+
+	save();
+}
+
+bool PipelineCache::isCompatible(const FileHeader& header, const std::string& data) const
+{
+	if (header.magic != PIPELINE_CACHE_MAGIC || header.version != PIPELINE_CACHE_FILE_VERSION)
+	{
+		return false;
+	}
+
+	if (header.vendorID != props.vendorID || header.deviceID != props.deviceID || header.driverVersion != props.driverVersion ||
+		std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		return false;
+	}
+
+	if (header.dataHash != hashBytes(data.data(), data.size()))
+	{
+		return false;
+	}
+
+	// The driver's own header has to agree as well
+	if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne))
+	{
+		return false;
+	}
+
+	VkPipelineCacheHeaderVersionOne vkHeader;
+	std::memcpy(&vkHeader, data.data(), sizeof(vkHeader));
+
+	return vkHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		vkHeader.vendorID == props.vendorID &&
+		vkHeader.deviceID == props.deviceID &&
+		std::memcmp(vkHeader.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+// VkPipelineCache backed by a file on disk. The blob is only reused when it was written by the
+// same device (vendor, device id, pipelineCacheUUID) and the same driver version.
+class PipelineCache
+{
+public:
+	// An empty path gives an in-memory cache that is never loaded or saved
+	void create(VkPhysicalDevice gpu, VkDevice device, const std::string& path);
+	void destroy();
+
+	// Writes the cache to disk; goes through a temp file so a crash never leaves a torn blob behind
+	bool save();
+	// Saves every checkpointInterval frames (0 disables checkpoints)
+	void checkpoint(uint64_t frameIndex, uint32_t checkpointInterval);
+
+	VkPipelineCache get() const { return cache; }
+	bool wasWarm() const { return warm; }
+	size_t loadedSize() const { return loadedBytes; }
+
+private:
+	// Prepended to the driver blob; driverVersion is not part of the Vulkan cache header
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t dataHash;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties props{};
+	std::string path;
+
+	bool warm = false;
+	size_t loadedBytes = 0;
+	size_t lastSavedSize = 0;
+
+	bool isCompatible(const FileHeader& header, const std::string& data) const;
+};
@@ -0,0 +1,172 @@
+#include "PipelineCompiler.h"
+#include "PipelineBuilder.h"
+#include "Profiler.h"
+#include "HostAllocator.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+void PipelineCompiler::create(VkDevice device_, VkPipelineCache cache_, ShaderModuleCache* shaders_, uint32_t threadCount)
+{
+	device = device_;
+	cache = cache_;
+	shaders = shaders_;
+	pool.start(threadCount > 0 ? threadCount : 1);
+}
+
+void PipelineCompiler::destroy()
+{
+	pool.stop();
+
+	uint32_t count = pipelineCount();
+	for (PipelineHandle h = 0; h < count; h++)
+	{
+		Entry& e = entry(h);
+		if (e.state == PipelineState::Ready)
+		{
+			vkDestroyPipeline(device, e.pipeline, hostCallbacks());
+		}
+	}
+
+	for (auto& chunk : chunks)
+	{
+		chunk.reset();
+	}
+	entryCount.store(0);
+}
+
+PipelineHandle PipelineCompiler::submit(const PipelineDesc& desc, VkPipelineLayout layout)
+{
+	Entry* e;
+	PipelineHandle handle;
+	{
+		std::lock_guard<std::mutex> lock(submitMutex);
+		handle = entryCount;
+		if (handle / CHUNK_SIZE >= MAX_CHUNKS)
+		{
+			throw std::runtime_error("too many pipelines submitted!");
+		}
+
+		auto& chunk = chunks[handle / CHUNK_SIZE];
+		if (!chunk)
+		{
+			chunk = std::make_unique<Entry[]>(CHUNK_SIZE);
+		}
+		e = &chunk[handle % CHUNK_SIZE];
+		e->desc = desc;
+		e->layout = layout;
+		e->submitted = Clock::now();
+		entryCount.store(handle + 1, std::memory_order_release);
+	}
+
+	pool.submit([this, e] { compile(*e); });
+
+	return handle;
+}
+
+void PipelineCompiler::release(PipelineHandle handle)
+{
+	Entry& e = entry(handle);
+	PipelineState state = e.state.load(std::memory_order_acquire);
+	if (state == PipelineState::Pending)
+	{
+		throw std::runtime_error("released a pipeline that is still compiling!");
+	}
+
+	if (state == PipelineState::Ready)
+	{
+		vkDestroyPipeline(device, e.pipeline, hostCallbacks());
+	}
+	e.pipeline.store(VK_NULL_HANDLE, std::memory_order_relaxed);
+	e.state.store(PipelineState::Released, std::memory_order_release);
+}
+
+VkPipeline PipelineCompiler::getIfReady(PipelineHandle handle) const
+{
+	const Entry& e = entry(handle);
+	return e.state.load(std::memory_order_acquire) == PipelineState::Ready ? e.pipeline.load(std::memory_order_relaxed) : VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineCompiler::resolve(PipelineHandle handle, VkPipeline fallback) const
+{
+	VkPipeline pipeline = getIfReady(handle);
+	return pipeline != VK_NULL_HANDLE ? pipeline : fallback;
+}
+
+PipelineState PipelineCompiler::getState(PipelineHandle handle) const
+{
+	return entry(handle).state.load(std::memory_order_acquire);
+}
+
+PipelineCompileTiming PipelineCompiler::getTiming(PipelineHandle handle) const
+{
+	const Entry& e = entry(handle);
+	if (e.state.load(std::memory_order_acquire) == PipelineState::Pending)
+	{
+		return {};
+	}
+	return e.timing;
+}
+
+std::string PipelineCompiler::getError(PipelineHandle handle) const
+{
+	const Entry& e = entry(handle);
+	if (e.state.load(std::memory_order_acquire) != PipelineState::Failed)
+	{
+		return {};
+	}
+	return e.error;
+}
+
+uint32_t PipelineCompiler::pipelineCount() const
+{
+	return entryCount.load(std::memory_order_acquire);
+}
+
+void PipelineCompiler::printTimings() const
+{
+	uint32_t count = pipelineCount();
+	for (PipelineHandle h = 0; h < count; h++)
+	{
+		const Entry& e = entry(h);
+		PipelineState state = e.state.load(std::memory_order_acquire);
+		const char* stateName = state == PipelineState::Ready ? "ready" : state == PipelineState::Failed ? "failed" : state == PipelineState::Released ? "released" : "pending";
+
+		PipelineCompileTiming t = getTiming(h);
+		printf("  pipeline %u (%s + %s): %s, queued %.2f ms, compiled in %.2f ms\n", h,
+			shaders->getLibrary().getPath(e.desc.vertShader).c_str(), shaders->getLibrary().getPath(e.desc.fragShader).c_str(), stateName, t.queuedMs, t.compileMs);
+	}
+}
+
+PipelineCompiler::Entry& PipelineCompiler::entry(PipelineHandle handle)
+{
+	return chunks[handle / CHUNK_SIZE][handle % CHUNK_SIZE];
+}
+
+const PipelineCompiler::Entry& PipelineCompiler::entry(PipelineHandle handle) const
+{
+	return chunks[handle / CHUNK_SIZE][handle % CHUNK_SIZE];
+}
+
+void PipelineCompiler::compile(Entry& e)
+{
+	using ms = std::chrono::duration<double, std::milli>;
+	PROFILE_SCOPE("compile pipeline");
+
+	Clock::time_point start = Clock::now();
+	e.timing.queuedMs = ms(start - e.submitted).count();
+
+	try
+	{
+		VkPipeline pipeline = buildGraphicsPipeline(device, cache, e.desc, e.layout, *shaders);
+		e.timing.compileMs = ms(Clock::now() - start).count();
+		e.pipeline.store(pipeline, std::memory_order_relaxed);
+		e.state.store(PipelineState::Ready, std::memory_order_release);
+	}
+	catch (const std::exception& ex)
+	{
+		e.timing.compileMs = ms(Clock::now() - start).count();
+		e.error = ex.what();
+		e.state.store(PipelineState::Failed, std::memory_order_release);
+	}
+}
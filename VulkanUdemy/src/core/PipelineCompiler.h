@@ -0,0 +1,86 @@
+#pragma once
+#include "PipelineDesc.h"
+#include "ShaderModuleCache.h"
+#include "ThreadPool.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+typedef uint32_t PipelineHandle;
+const PipelineHandle INVALID_PIPELINE = UINT32_MAX;
+
+enum class PipelineState
+{
+	Pending,
+	Ready,
+	Failed,
+	Released	// destroyed by release(); the handle stays valid but never resolves again
+};
+
+struct PipelineCompileTiming
+{
+	double queuedMs = 0.0;	// submit -> a worker picked it up
+	double compileMs = 0.0;	// time inside vkCreateGraphicsPipelines (incl. first shader module creation)
+};
+
+// Builds pipelines on worker threads against one shared VkPipelineCache.
+// The render loop polls getIfReady() and draws with a fallback (or skips) until a pipeline lands.
+class PipelineCompiler
+{
+public:
+	void create(VkDevice device, VkPipelineCache cache, ShaderModuleCache* shaders, uint32_t threadCount);
+	// Waits for outstanding compiles and destroys every pipeline it built
+	void destroy();
+
+	PipelineHandle submit(const PipelineDesc& desc, VkPipelineLayout layout);
+	void waitIdle() { pool.waitIdle(); }
+	// Destroys a finished pipeline early (hot reload); the caller guarantees the GPU is done with it
+	void release(PipelineHandle handle);
+
+	// Lock-free; VK_NULL_HANDLE while the pipeline is still compiling or failed
+	VkPipeline getIfReady(PipelineHandle handle) const;
+	// getIfReady, but returns fallback instead of VK_NULL_HANDLE
+	VkPipeline resolve(PipelineHandle handle, VkPipeline fallback) const;
+
+	PipelineState getState(PipelineHandle handle) const;
+	PipelineCompileTiming getTiming(PipelineHandle handle) const;
+	std::string getError(PipelineHandle handle) const;
+	uint32_t pipelineCount() const;
+
+	void printTimings() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Entry
+	{
+		PipelineDesc desc;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		std::atomic<VkPipeline> pipeline{ VK_NULL_HANDLE };
+		std::atomic<PipelineState> state{ PipelineState::Pending };
+		Clock::time_point submitted;
+		PipelineCompileTiming timing;
+		std::string error;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	ShaderModuleCache* shaders = nullptr;
+	ThreadPool pool;
+
+	// Entries live in fixed-size chunks that are never moved or freed until destroy(),
+	// so a handle can be turned into an Entry without taking the lock
+	static const uint32_t CHUNK_SIZE = 64;
+	static const uint32_t MAX_CHUNKS = 1024;
+	std::array<std::unique_ptr<Entry[]>, MAX_CHUNKS> chunks;
+	std::atomic<uint32_t> entryCount{ 0 };
+	std::mutex submitMutex;
+
+	Entry& entry(PipelineHandle handle);
+	const Entry& entry(PipelineHandle handle) const;
+	void compile(Entry& e);
+};
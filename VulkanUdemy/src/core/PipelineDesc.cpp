@@ -0,0 +1,119 @@
+#include "PipelineDesc.h"
+#include "Hash.h"
+
+#include <stdexcept>
+
+// Fields are hashed one by one so padding bytes never leak into the key
+
+uint64_t PipelineLayoutDesc::hash() const
+{
+	uint64_t h = hashCombine(1469598103934665603ull, setLayoutCount);
+	for (uint32_t i = 0; i < setLayoutCount; i++)
+	{
+		h = hashCombine(h, setLayouts[i]);
+	}
+	h = hashCombine(h, pushConstantStages);
+	h = hashCombine(h, pushConstantSize);
+	return h;
+}
+
+static uint32_t formatSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R32_SFLOAT: case VK_FORMAT_R32_SINT: case VK_FORMAT_R32_UINT: return 4;
+	case VK_FORMAT_R32G32_SFLOAT: case VK_FORMAT_R32G32_SINT: case VK_FORMAT_R32G32_UINT: return 8;
+	case VK_FORMAT_R32G32B32_SFLOAT: case VK_FORMAT_R32G32B32_SINT: case VK_FORMAT_R32G32B32_UINT: return 12;
+	case VK_FORMAT_R32G32B32A32_SFLOAT: case VK_FORMAT_R32G32B32A32_SINT: case VK_FORMAT_R32G32B32A32_UINT: return 16;
+	default: break;
+	}
+	throw std::runtime_error("unsupported vertex attribute format!");
+}
+
+VertexLayoutDesc VertexLayoutDesc::packed(const ShaderReflection& reflection)
+{
+	VertexLayoutDesc layout;
+	for (const ReflectedVertexInput& input : reflection.vertexInputs)
+	{
+		if (layout.attributeCount == MAX_ATTRIBUTES)
+		{
+			throw std::runtime_error("too many vertex attributes!");
+		}
+
+		Attribute& attribute = layout.attributes[layout.attributeCount++];
+		attribute.location = input.location;
+		attribute.format = input.format;
+		attribute.offset = layout.stride;
+		layout.stride += formatSize(input.format);
+	}
+	return layout;
+}
+
+uint64_t VertexLayoutDesc::hash() const
+{
+	uint64_t h = hashCombine(1469598103934665603ull, attributeCount);
+	for (uint32_t i = 0; i < attributeCount; i++)
+	{
+		h = hashCombine(h, attributes[i].location);
+		h = hashCombine(h, attributes[i].format);
+		h = hashCombine(h, attributes[i].offset);
+	}
+	h = hashCombine(h, stride);
+	return h;
+}
+
+void SpecializationDesc::set(uint32_t id, uint32_t value)
+{
+	uint32_t i = 0;
+	while (i < count && ids[i] < id)
+	{
+		i++;
+	}
+
+	if (i < count && ids[i] == id)
+	{
+		values[i] = value;
+		return;
+	}
+	if (count == MAX_CONSTANTS)
+	{
+		throw std::runtime_error("too many specialization constants!");
+	}
+
+	for (uint32_t j = count; j > i; j--)
+	{
+		ids[j] = ids[j - 1];
+		values[j] = values[j - 1];
+	}
+	ids[i] = id;
+	values[i] = value;
+	count++;
+}
+
+uint64_t SpecializationDesc::hash() const
+{
+	uint64_t h = hashCombine(1469598103934665603ull, count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		h = hashCombine(h, ids[i]);
+		h = hashCombine(h, values[i]);
+	}
+	return h;
+}
+
+uint64_t PipelineDesc::hash() const
+{
+	uint64_t h = hashCombine(layout.hash(), vertShader);
+	h = hashCombine(h, fragShader);
+	h = hashCombine(h, subpass);
+	h = hashCombine(h, topology);
+	h = hashCombine(h, polygonMode);
+	h = hashCombine(h, cullMode);
+	h = hashCombine(h, frontFace);
+	h = hashCombine(h, blendEnable);
+	h = hashCombine(h, dynamicStates);
+	h = hashCombine(h, renderPass);
+	h = hashCombine(h, vertexLayout.hash());
+	h = hashCombine(h, specialization.hash());
+	return h;
+}
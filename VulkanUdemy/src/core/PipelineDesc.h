@@ -0,0 +1,85 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "ShaderLibrary.h"
+#include "ShaderReflection.h"
+
+// Descriptor set layouts + push constants; identical descriptions share one VkPipelineLayout
+struct PipelineLayoutDesc
+{
+	static const uint32_t MAX_SETS = 4;
+
+	VkDescriptorSetLayout setLayouts[MAX_SETS] = {};
+	uint32_t setLayoutCount = 0;
+	VkShaderStageFlags pushConstantStages = 0;
+	uint32_t pushConstantSize = 0;
+
+	uint64_t hash() const;
+	bool operator==(const PipelineLayoutDesc& other) const = default;
+};
+
+// Attributes of one interleaved, per-vertex buffer at binding 0
+struct VertexLayoutDesc
+{
+	static const uint32_t MAX_ATTRIBUTES = 8;
+
+	struct Attribute
+	{
+		uint32_t location = 0;
+		uint32_t format = VK_FORMAT_UNDEFINED;
+		uint32_t offset = 0;
+
+		bool operator==(const Attribute& other) const = default;
+	};
+
+	Attribute attributes[MAX_ATTRIBUTES] = {};
+	uint32_t attributeCount = 0;
+	uint32_t stride = 0;
+
+	// Tightly packed in location order, matching a plain C++ struct of floats/ints
+	static VertexLayoutDesc packed(const ShaderReflection& reflection);
+
+	uint64_t hash() const;
+	bool operator==(const VertexLayoutDesc& other) const = default;
+};
+
+// Specialization constants (32-bit values) applied to every stage; a stage ignores ids it doesn't declare.
+// Ids are kept sorted so the same set of constants always hashes the same.
+struct SpecializationDesc
+{
+	static const uint32_t MAX_CONSTANTS = 8;
+
+	uint32_t ids[MAX_CONSTANTS] = {};
+	uint32_t values[MAX_CONSTANTS] = {};
+	uint32_t count = 0;
+
+	void set(uint32_t id, uint32_t value);
+
+	uint64_t hash() const;
+	bool operator==(const SpecializationDesc& other) const = default;
+};
+
+// Fixed-size value describing one graphics pipeline. Enum state is packed into bytes;
+// viewport and scissor are expected to stay dynamic.
+struct PipelineDesc
+{
+	ShaderId vertShader = 0;
+	ShaderId fragShader = 0;
+
+	uint8_t subpass = 0;
+	uint8_t topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	uint8_t polygonMode = VK_POLYGON_MODE_FILL;
+	uint8_t cullMode = VK_CULL_MODE_BACK_BIT;
+	uint8_t frontFace = VK_FRONT_FACE_CLOCKWISE;
+	uint8_t blendEnable = 0;
+	// bit i set = VkDynamicState i is dynamic (core states only)
+	uint16_t dynamicStates = (1 << VK_DYNAMIC_STATE_VIEWPORT) | (1 << VK_DYNAMIC_STATE_SCISSOR);
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	PipelineLayoutDesc layout;
+	VertexLayoutDesc vertexLayout;
+	SpecializationDesc specialization;
+
+	uint64_t hash() const;
+	bool operator==(const PipelineDesc& other) const = default;
+};
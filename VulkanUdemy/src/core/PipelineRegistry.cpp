@@ -0,0 +1,210 @@
+#include "PipelineRegistry.h"
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+void PipelineRegistry::create(VkDevice device_, PipelineCompiler* compiler_, size_t expectedPipelines)
+{
+	device = device_;
+	compiler = compiler_;
+
+	// Sized up front so the map never rehashes during normal use
+	pipelines.reserve(expectedPipelines);
+	layouts.reserve(expectedPipelines);
+}
+
+void PipelineRegistry::destroy()
+{
+	for (auto& [hash, entry] : layouts)
+	{
+		vkDestroyPipelineLayout(device, entry.layout, hostCallbacks());
+	}
+	layouts.clear();
+	pipelines.clear();
+	retired.clear();
+	pendingCount = 0;
+}
+
+PipelineKey PipelineRegistry::request(const PipelineDesc& desc)
+{
+	requests++;
+
+	PipelineKey key = desc.hash();
+	auto it = pipelines.find(key);
+	if (it != pipelines.end())
+	{
+		if (!(it->second.desc == desc))
+		{
+			throw std::runtime_error("pipeline description hash collision!");
+		}
+		hits++;
+		return key;
+	}
+
+	RegisteredPipeline entry;
+	entry.desc = desc;
+	entry.layout = acquireLayout(desc.layout);
+	entry.pipeline = compiler->submit(desc, entry.layout);
+	pipelines.emplace(key, entry);
+
+	return key;
+}
+
+uint32_t PipelineRegistry::rebuildUsing(ShaderId shader)
+{
+	uint32_t submitted = 0;
+	for (auto& [key, entry] : pipelines)
+	{
+		if (entry.desc.vertShader != shader && entry.desc.fragShader != shader)
+		{
+			continue;
+		}
+
+		// A newer edit supersedes a rebuild that hasn't landed yet
+		if (entry.pending != INVALID_PIPELINE)
+		{
+			retired.push_back({ entry.pending, 0 });
+			pendingCount--;
+		}
+		entry.pending = compiler->submit(entry.desc, entry.layout);
+		pendingCount++;
+		submitted++;
+	}
+	return submitted;
+}
+
+void PipelineRegistry::update(uint64_t frameNumber, uint32_t framesInFlight)
+{
+	if (pendingCount > 0)
+	{
+		for (auto& [key, entry] : pipelines)
+		{
+			if (entry.pending == INVALID_PIPELINE)
+			{
+				continue;
+			}
+
+			PipelineState state = compiler->getState(entry.pending);
+			if (state == PipelineState::Ready)
+			{
+				retired.push_back({ entry.pipeline, frameNumber });
+				entry.pipeline = entry.pending;
+			}
+			else if (state == PipelineState::Failed)
+			{
+				// Keep drawing with the previous pipeline; the next save triggers another try
+				printf("pipeline rebuild failed, keeping previous version: %s\n", compiler->getError(entry.pending).c_str());
+				retired.push_back({ entry.pending, 0 });
+			}
+			else
+			{
+				continue;
+			}
+			entry.pending = INVALID_PIPELINE;
+			pendingCount--;
+		}
+	}
+
+	// Command buffers recorded before frameNumber may still be executing until their fences come round
+	for (size_t i = 0; i < retired.size();)
+	{
+		const Retired& r = retired[i];
+		if (compiler->getState(r.pipeline) != PipelineState::Pending && frameNumber >= r.frameNumber + framesInFlight)
+		{
+			compiler->release(r.pipeline);
+			retired[i] = retired.back();
+			retired.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+const RegisteredPipeline* PipelineRegistry::find(PipelineKey key) const
+{
+	auto it = pipelines.find(key);
+	return it != pipelines.end() ? &it->second : nullptr;
+}
+
+VkPipeline PipelineRegistry::getIfReady(PipelineKey key) const
+{
+	const RegisteredPipeline* entry = find(key);
+	return entry != nullptr ? compiler->getIfReady(entry->pipeline) : VK_NULL_HANDLE;
+}
+
+VkPipelineLayout PipelineRegistry::getLayout(PipelineKey key) const
+{
+	const RegisteredPipeline* entry = find(key);
+	return entry != nullptr ? entry->layout : VK_NULL_HANDLE;
+}
+
+PipelineRegistryStats PipelineRegistry::getStats() const
+{
+	PipelineRegistryStats stats;
+	stats.requests = requests;
+	stats.hits = hits;
+	stats.pipelineCount = static_cast<uint32_t>(pipelines.size());
+	stats.layoutCount = static_cast<uint32_t>(layouts.size());
+
+	for (const auto& [key, entry] : pipelines)
+	{
+		if (compiler->getState(entry.pipeline) == PipelineState::Ready)
+		{
+			double ms = compiler->getTiming(entry.pipeline).compileMs;
+			stats.pipelinesReady++;
+			stats.totalCreateMs += ms;
+			stats.maxCreateMs = std::max(stats.maxCreateMs, ms);
+		}
+	}
+
+	return stats;
+}
+
+void PipelineRegistry::printStats() const
+{
+	PipelineRegistryStats stats = getStats();
+	double hitRate = stats.requests > 0 ? 100.0 * static_cast<double>(stats.hits) / static_cast<double>(stats.requests) : 0.0;
+
+	printf("pipeline registry: %u pipelines (%u ready), %u layouts, %llu requests, %.1f%% hit rate\n",
+		stats.pipelineCount, stats.pipelinesReady, stats.layoutCount, static_cast<unsigned long long>(stats.requests), hitRate);
+	printf("  creation time: %.2f ms total, %.2f ms worst\n", stats.totalCreateMs, stats.maxCreateMs);
+}
+
+VkPipelineLayout PipelineRegistry::acquireLayout(const PipelineLayoutDesc& desc)
+{
+	uint64_t hash = desc.hash();
+	auto it = layouts.find(hash);
+	if (it != layouts.end())
+	{
+		if (!(it->second.desc == desc))
+		{
+			throw std::runtime_error("pipeline layout description hash collision!");
+		}
+		return it->second.layout;
+	}
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = desc.pushConstantStages;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = desc.pushConstantSize;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = desc.setLayoutCount;
+	pipelineLayoutInfo.pSetLayouts = desc.setLayouts;
+	pipelineLayoutInfo.pushConstantRangeCount = desc.pushConstantSize > 0 ? 1 : 0;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	VkPipelineLayout layout;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostCallbacks(), &layout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	layouts.emplace(hash, RegisteredLayout{ desc, layout });
+	return layout;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "PipelineCompiler.h"
+#include "PipelineDesc.h"
+
+#include <unordered_map>
+#include <vector>
+
+typedef uint64_t PipelineKey;
+
+struct RegisteredPipeline
+{
+	PipelineDesc desc;
+	PipelineHandle pipeline;
+	VkPipelineLayout layout;
+	PipelineHandle pending = INVALID_PIPELINE;	// rebuild in flight; swapped in by update() once ready
+};
+
+struct PipelineRegistryStats
+{
+	uint64_t requests = 0;
+	uint64_t hits = 0;
+	uint32_t pipelineCount = 0;
+	uint32_t layoutCount = 0;
+	uint32_t pipelinesReady = 0;
+	double totalCreateMs = 0.0;	// summed compile time of every ready pipeline
+	double maxCreateMs = 0.0;
+};
+
+// Deduplicates pipelines and pipeline layouts by description hash. request() is the slow path
+// (may create objects); find() is the per-draw lookup and never allocates.
+class PipelineRegistry
+{
+public:
+	void create(VkDevice device, PipelineCompiler* compiler, size_t expectedPipelines = 256);
+	// Pipelines are owned by the compiler; this destroys the layouts
+	void destroy();
+
+	// Returns the key to use with find()/getIfReady(); submits a compile only on first sight
+	PipelineKey request(const PipelineDesc& desc);
+
+	// Hot reload: recompiles every pipeline that uses the shader. The old pipeline keeps
+	// drawing until the new one is ready; returns how many rebuilds were submitted.
+	uint32_t rebuildUsing(ShaderId shader);
+	// Call once per frame after the frame fence wait. Swaps in finished rebuilds and destroys
+	// replaced pipelines once no frame in flight can still reference them.
+	void update(uint64_t frameNumber, uint32_t framesInFlight);
+
+	const RegisteredPipeline* find(PipelineKey key) const;
+	VkPipeline getIfReady(PipelineKey key) const;
+	VkPipelineLayout getLayout(PipelineKey key) const;
+
+	PipelineRegistryStats getStats() const;
+	void printStats() const;
+
+private:
+	// Keys are already hashes
+	struct IdentityHash
+	{
+		size_t operator()(uint64_t key) const { return static_cast<size_t>(key); }
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	PipelineCompiler* compiler = nullptr;
+
+	std::unordered_map<PipelineKey, RegisteredPipeline, IdentityHash> pipelines;
+	struct RegisteredLayout
+	{
+		PipelineLayoutDesc desc;	// checked on a hash hit
+		VkPipelineLayout layout;
+	};
+	std::unordered_map<uint64_t, RegisteredLayout, IdentityHash> layouts;
+
+	struct Retired
+	{
+		PipelineHandle pipeline;
+		uint64_t frameNumber;
+	};
+	std::vector<Retired> retired;
+	uint32_t pendingCount = 0;
+
+	uint64_t requests = 0;
+	uint64_t hits = 0;
+
+	VkPipelineLayout acquireLayout(const PipelineLayoutDesc& desc);
+};
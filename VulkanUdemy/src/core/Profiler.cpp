@@ -0,0 +1,305 @@
+#include "Profiler.h"
+#include "HostAllocator.h"
+#include "VulkanDispatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+Profiler& Profiler::get()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::Ticks Profiler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::ThreadRing::push(const char* eventName, Ticks begin, Ticks end)
+{
+	uint64_t index = head.load(std::memory_order_relaxed);
+	events[index % RING_SIZE] = { eventName, begin, end };
+	head.store(index + 1, std::memory_order_release);
+}
+
+Profiler::ThreadRing& Profiler::threadRing()
+{
+	thread_local ThreadRing* ring = nullptr;
+	if (ring == nullptr)
+	{
+		ring = new ThreadRing();
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		ring->id = static_cast<uint32_t>(rings.size()) + 1;
+		ring->name = "thread " + std::to_string(ring->id);
+		rings.push_back(ring);
+	}
+	return *ring;
+}
+
+void Profiler::record(const char* name, Ticks begin, Ticks end)
+{
+	threadRing().push(name, begin, end);
+}
+
+void Profiler::setThreadName(const char* name)
+{
+	ThreadRing& ring = threadRing();
+	std::lock_guard<std::mutex> lock(ringsMutex);
+	ring.name = name;
+}
+
+void Profiler::createGpu(VkPhysicalDevice physicalDevice, VkDevice device_, VkQueue queue, uint32_t queueFamily, uint32_t framesInFlight)
+{
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+	uint32_t validBits = families[queueFamily].timestampValidBits;
+	if (validBits == 0)
+	{
+		return;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	device = device_;
+	timestampPeriod = properties.limits.timestampPeriod;
+	timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	VkQueryPoolCreateInfo queryInfo{};
+	queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryInfo.queryCount = 2 * MAX_GPU_SCOPES * framesInFlight;
+	if (vkCreateQueryPool(device, &queryInfo, hostCallbacks(), &queryPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create timestamp query pool!");
+	}
+	gpuSlots.assign(framesInFlight, GpuSlot{});
+	gpuRing.name = "GPU";
+
+	calibrate(queue, queueFamily);
+}
+
+void Profiler::destroyGpu()
+{
+	if (queryPool != VK_NULL_HANDLE)
+	{
+		// The device is idle: pick up the last frames' scopes too
+		for (uint32_t slot = 0; slot < gpuSlots.size(); slot++)
+		{
+			resolveSlot(slot);
+		}
+		vkDestroyQueryPool(device, queryPool, hostCallbacks());
+		queryPool = VK_NULL_HANDLE;
+	}
+	gpuSlots.clear();
+}
+
+void Profiler::calibrate(VkQueue queue, uint32_t queueFamily)
+{
+	// One timestamp on an otherwise idle queue, taken to be halfway between submit and the fence returning
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	VkCommandPool commandPool;
+	if (vkCreateCommandPool(device, &poolInfo, hostCallbacks(), &commandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create profiler command pool!");
+	}
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+	VkCommandBuffer commandBuffer;
+	vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkd().vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	vkd().vkCmdResetQueryPool(commandBuffer, queryPool, 0, 1);
+	vkd().vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+	vkd().vkEndCommandBuffer(commandBuffer);
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkFence fence;
+	if (vkCreateFence(device, &fenceInfo, hostCallbacks(), &fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create profiler fence!");
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	Ticks submitted = now();
+	if (vkd().vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to submit profiler calibration!");
+	}
+	vkd().vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	Ticks signalled = now();
+
+	vkd().vkGetQueryPoolResults(device, queryPool, 0, 1, sizeof(uint64_t), &calibrationTicks, sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+	calibrationTicks &= timestampMask;
+	calibrationTime = submitted + (signalled - submitted) / 2;
+
+	vkDestroyFence(device, fence, hostCallbacks());
+	vkDestroyCommandPool(device, commandPool, hostCallbacks());
+}
+
+void Profiler::beginGpuFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot)
+{
+	if (queryPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	resolveSlot(frameSlot);
+	currentSlot = frameSlot;
+	vkd().vkCmdResetQueryPool(commandBuffer, queryPool, 2 * MAX_GPU_SCOPES * frameSlot, 2 * MAX_GPU_SCOPES);
+}
+
+uint32_t Profiler::beginGpuScope(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (queryPool == VK_NULL_HANDLE || !isEnabled())
+	{
+		return UINT32_MAX;
+	}
+
+	GpuSlot& slot = gpuSlots[currentSlot];
+	if (slot.names.size() >= MAX_GPU_SCOPES)
+	{
+		return UINT32_MAX;
+	}
+	uint32_t scope = static_cast<uint32_t>(slot.names.size());
+	slot.names.push_back(name);
+	vkd().vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * (MAX_GPU_SCOPES * currentSlot + scope));
+	return scope;
+}
+
+void Profiler::endGpuScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+	if (scope == UINT32_MAX)
+	{
+		return;
+	}
+	vkd().vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * (MAX_GPU_SCOPES * currentSlot + scope) + 1);
+}
+
+void Profiler::resolveSlot(uint32_t frameSlot)
+{
+	GpuSlot& slot = gpuSlots[frameSlot];
+	if (slot.names.empty())
+	{
+		return;
+	}
+
+	// The slot's fence has signalled, so without WAIT this only fails if the frame was never submitted
+	uint32_t count = 2 * static_cast<uint32_t>(slot.names.size());
+	uint64_t ticks[2 * MAX_GPU_SCOPES];
+	VkResult result = vkd().vkGetQueryPoolResults(device, queryPool, 2 * MAX_GPU_SCOPES * frameSlot, count, sizeof(uint64_t) * count, ticks,
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result == VK_SUCCESS)
+	{
+		for (size_t i = 0; i < slot.names.size(); i++)
+		{
+			// Ticks since the calibration timestamp, converted to CPU nanoseconds
+			int64_t begin = static_cast<int64_t>((ticks[2 * i] & timestampMask) - calibrationTicks);
+			int64_t end = static_cast<int64_t>((ticks[2 * i + 1] & timestampMask) - calibrationTicks);
+			gpuRing.push(slot.names[i], calibrationTime + static_cast<Ticks>(begin * timestampPeriod),
+				calibrationTime + static_cast<Ticks>(end * timestampPeriod));
+
+			double ms = (end - begin) * timestampPeriod / 1e6;
+			auto it = std::find_if(gpuTotals.begin(), gpuTotals.end(), [&](const GpuTotal& t) { return t.name == slot.names[i]; });
+			if (it == gpuTotals.end())
+			{
+				gpuTotals.push_back({ slot.names[i], ms, 1 });
+			}
+			else
+			{
+				it->ms += ms;
+				it->count++;
+			}
+		}
+	}
+	slot.names.clear();
+}
+
+void Profiler::writeChromeTrace(const std::string& path)
+{
+	struct Track
+	{
+		const ThreadRing* ring;
+		uint32_t pid;
+		std::vector<Event> events;
+	};
+
+	std::vector<Track> tracks;
+	{
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		for (const ThreadRing* ring : rings)
+		{
+			tracks.push_back({ ring, 1, {} });
+		}
+	}
+	tracks.push_back({ &gpuRing, 2, {} });
+
+	// Oldest event still in each ring; the trace starts at the earliest of them
+	Ticks origin = INT64_MAX;
+	for (Track& track : tracks)
+	{
+		uint64_t head = track.ring->head.load(std::memory_order_acquire);
+		uint64_t first = head > RING_SIZE ? head - RING_SIZE : 0;
+		for (uint64_t i = first; i < head; i++)
+		{
+			track.events.push_back(track.ring->events[i % RING_SIZE]);
+			origin = std::min(origin, track.events.back().begin);
+		}
+	}
+
+	FILE* file = fopen(path.c_str(), "w");
+	if (file == nullptr)
+	{
+		throw std::runtime_error("failed to open trace file " + path + "!");
+	}
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	size_t eventCount = 0;
+	for (const Track& track : tracks)
+	{
+		fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			&track == &tracks.front() ? "" : ",", track.pid, track.ring->id, track.ring->name.c_str());
+		for (const Event& event : track.events)
+		{
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				event.name, track.pid, track.ring->id, (event.begin - origin) / 1000.0, (event.end - event.begin) / 1000.0);
+		}
+		eventCount += track.events.size();
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	printf("trace: %zu events from %zu threads written to %s\n", eventCount, tracks.size() - 1, path.c_str());
+}
+
+void Profiler::printGpuStats() const
+{
+	if (queryPool == VK_NULL_HANDLE)
+	{
+		printf("gpu scopes: no timestamps on the graphics queue\n");
+		return;
+	}
+	printf("gpu scopes:\n");
+	for (const GpuTotal& total : gpuTotals)
+	{
+		printf("  %-20s %8.3f ms avg over %llu frames\n", total.name, total.ms / total.count, static_cast<unsigned long long>(total.count));
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU scopes and GPU timestamps on one timeline, exported as a Chrome trace (chrome://tracing, Perfetto).
+//  - CPU: PROFILE_SCOPE("name") writes begin/end into a per-thread ring; one relaxed load, two clock reads and a
+//    store, no locks after a thread's first scope. Names must be string literals (only the pointer is kept).
+//  - GPU: GpuScope writes vkCmdWriteTimestamp pairs into the frame slot's query range. They are read back when
+//    the slot comes round again, after its fence wait, so reading never stalls.
+// GPU ticks are mapped to the CPU clock with an offset measured at createGpu().
+class Profiler
+{
+public:
+	typedef int64_t Ticks;	// steady_clock nanoseconds
+
+	static const uint32_t RING_SIZE = 1 << 16;		// events kept per thread
+	static const uint32_t MAX_GPU_SCOPES = 64;		// per frame
+
+	static Profiler& get();
+
+	void setEnabled(bool enabled_) { enabled.store(enabled_, std::memory_order_relaxed); }
+	bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+	// Shown as the track name in the trace
+	void setThreadName(const char* name);
+
+	// No GPU scopes if the queue family has no timestamps
+	void createGpu(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamily, uint32_t framesInFlight);
+	// Call after vkDeviceWaitIdle
+	void destroyGpu();
+
+	// First thing recorded into a slot's command buffer, after its fence wait: resolves the slot's
+	// previous scopes and resets its queries
+	void beginGpuFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+	// UINT32_MAX when out of queries or disabled; endGpuScope ignores it
+	uint32_t beginGpuScope(VkCommandBuffer commandBuffer, const char* name);
+	void endGpuScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+	// Call with the device idle and no scopes open on other threads
+	void writeChromeTrace(const std::string& path);
+	// Average GPU time per scope name over the frames read back so far
+	void printGpuStats() const;
+
+	static Ticks now();
+	void record(const char* name, Ticks begin, Ticks end);
+
+private:
+	struct Event
+	{
+		const char* name;
+		Ticks begin;
+		Ticks end;
+	};
+
+	// Written only by its own thread; head is published with release so the exporter sees whole events
+	struct ThreadRing
+	{
+		Event events[RING_SIZE];
+		std::atomic<uint64_t> head{ 0 };
+		std::string name;
+		uint32_t id = 0;
+
+		void push(const char* name, Ticks begin, Ticks end);
+	};
+
+	struct GpuSlot
+	{
+		std::vector<const char*> names;	// one per scope; query 2 * i begins it, 2 * i + 1 ends it
+	};
+
+	struct GpuTotal
+	{
+		const char* name;
+		double ms;
+		uint64_t count;
+	};
+
+	std::atomic<bool> enabled{ true };
+	std::mutex ringsMutex;
+	std::vector<ThreadRing*> rings;	// never freed: a thread's ring outlives it so its events can still be exported
+	ThreadRing gpuRing;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	std::vector<GpuSlot> gpuSlots;
+	uint32_t currentSlot = 0;
+	double timestampPeriod = 0.0;	// ns per tick
+	uint64_t timestampMask = 0;
+	uint64_t calibrationTicks = 0;	// a GPU timestamp and the CPU time it was taken at
+	Ticks calibrationTime = 0;
+	std::vector<GpuTotal> gpuTotals;
+
+	Profiler() = default;
+
+	ThreadRing& threadRing();
+	void calibrate(VkQueue queue, uint32_t queueFamily);
+	void resolveSlot(uint32_t frameSlot);
+};
+
+// Times the enclosing block on the calling thread
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name_) : name(name_), begin(Profiler::get().isEnabled() ? Profiler::now() : 0) {}
+	~ProfileScope()
+	{
+		if (begin != 0)
+		{
+			Profiler::get().record(name, begin, Profiler::now());
+		}
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* name;
+	Profiler::Ticks begin;
+};
+
+// Times the commands recorded in the enclosing block
+class GpuScope
+{
+public:
+	GpuScope(VkCommandBuffer commandBuffer_, const char* name) : commandBuffer(commandBuffer_), scope(Profiler::get().beginGpuScope(commandBuffer_, name)) {}
+	~GpuScope() { Profiler::get().endGpuScope(commandBuffer, scope); }
+
+	GpuScope(const GpuScope&) = delete;
+	GpuScope& operator=(const GpuScope&) = delete;
+
+private:
+	VkCommandBuffer commandBuffer;
+	uint32_t scope;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(commandBuffer, name) GpuScope PROFILE_CONCAT(gpuScope, __LINE__)(commandBuffer, name)
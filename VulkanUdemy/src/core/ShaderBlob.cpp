@@ -0,0 +1,130 @@
+#include "ShaderBlob.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+ShaderBlob::ShaderBlob(const std::string& path)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("failed to open file: " + path);
+	}
+	fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		release();
+		throw std::runtime_error("failed to read file: " + path);
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle != nullptr)
+	{
+		data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw std::runtime_error("failed to open file: " + path);
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		throw std::runtime_error("failed to read file: " + path);
+	}
+	size = static_cast<size_t>(st.st_size);
+
+	void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped != MAP_FAILED)
+	{
+		data = mapped;
+	}
+#endif
+
+	if (data == nullptr)
+	{
+		release();
+		throw std::runtime_error("failed to map file: " + path);
+	}
+
+	if (size % sizeof(uint32_t) != 0 || words()[0] != SPIRV_MAGIC)
+	{
+		release();
+		throw std::runtime_error("not a SPIR-V binary: " + path);
+	}
+}
+
+ShaderBlob::~ShaderBlob()
+{
+	release();
+}
+
+ShaderBlob::ShaderBlob(ShaderBlob&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+ShaderBlob& ShaderBlob::operator=(ShaderBlob&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		data = std::exchange(other.data, nullptr);
+		size = std::exchange(other.size, 0);
+#ifdef _WIN32
+		fileHandle = std::exchange(other.fileHandle, nullptr);
+		mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+	}
+	return *this;
+}
+
+void ShaderBlob::release()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle != nullptr)
+	{
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != nullptr)
+	{
+		CloseHandle(fileHandle);
+	}
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+#else
+	if (data != nullptr)
+	{
+		munmap(const_cast<void*>(data), size);
+	}
+#endif
+	data = nullptr;
+	size = 0;
+}
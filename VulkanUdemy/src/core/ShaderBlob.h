@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a SPIR-V file. Mappings are page aligned, so words() can go
+// straight into VkShaderModuleCreateInfo::pCode with no copy.
+class ShaderBlob
+{
+public:
+	ShaderBlob() = default;
+	explicit ShaderBlob(const std::string& path);
+	~ShaderBlob();
+
+	ShaderBlob(ShaderBlob&& other) noexcept;
+	ShaderBlob& operator=(ShaderBlob&& other) noexcept;
+	ShaderBlob(const ShaderBlob&) = delete;
+	ShaderBlob& operator=(const ShaderBlob&) = delete;
+
+	const uint32_t* words() const { return static_cast<const uint32_t*>(data); }
+	size_t wordCount() const { return size / sizeof(uint32_t); }
+	size_t sizeBytes() const { return size; }
+
+private:
+	const void* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+
+	void release();
+};
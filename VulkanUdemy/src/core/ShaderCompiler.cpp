@@ -0,0 +1,157 @@
+#include "ShaderCompiler.h"
+#include "Hash.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef USE_SHADERC
+#include <shaderc/shaderc.h>
+#endif
+
+// Bump when compile options change so stale cache entries are ignored
+static const uint32_t SHADER_CACHE_VERSION = 1;
+
+enum class ShaderStage
+{
+	Vertex,
+	Fragment
+};
+
+static ShaderStage stageFromPath(const std::string& path)
+{
+	std::filesystem::path p(path);
+	std::string name = p.filename().string();
+	std::string dir = p.parent_path().filename().string();
+	std::string ext = p.extension().string();
+
+	if (ext == ".vert" || dir == "vertex" || name.rfind("vert", 0) == 0)
+	{
+		return ShaderStage::Vertex;
+	}
+	if (ext == ".frag" || dir == "fragment" || name.rfind("frag", 0) == 0)
+	{
+		return ShaderStage::Fragment;
+	}
+
+	throw std::runtime_error("can't tell the shader stage of " + path);
+}
+
+void ShaderCompiler::create(const std::string& cacheDir_)
+{
+	cacheDir = cacheDir_;
+	std::filesystem::create_directories(cacheDir);
+
+#ifdef USE_SHADERC
+	compiler = shaderc_compiler_initialize();
+#endif
+}
+
+void ShaderCompiler::destroy()
+{
+#ifdef USE_SHADERC
+	if (compiler != nullptr)
+	{
+		shaderc_compiler_release(static_cast<shaderc_compiler_t>(compiler));
+	}
+#endif
+	compiler = nullptr;
+}
+
+bool ShaderCompiler::isAvailable()
+{
+#ifdef USE_SHADERC
+	return true;
+#else
+	return false;
+#endif
+}
+
+std::string ShaderCompiler::compile(const std::string& sourcePath, const std::string& defines)
+{
+	std::ifstream file(sourcePath, std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("failed to open file: " + sourcePath);
+	}
+	std::stringstream contents;
+	contents << file.rdbuf();
+	std::string source = contents.str();
+
+	ShaderStage stage = stageFromPath(sourcePath);
+
+	uint64_t key = hashBytes(source.data(), source.size());
+	key = hashBytes(defines.data(), defines.size(), key);
+	key = hashCombine(key, stage);
+	key = hashCombine(key, SHADER_CACHE_VERSION);
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(key));
+	std::string spvPath = (std::filesystem::path(cacheDir) / name).string();
+
+	if (std::filesystem::exists(spvPath))
+	{
+		cached++;
+		return spvPath;
+	}
+
+#ifdef USE_SHADERC
+	shaderc_compile_options_t options = shaderc_compile_options_initialize();
+	shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+
+	std::stringstream defineList(defines);
+	std::string define;
+	while (std::getline(defineList, define, ';'))
+	{
+		if (define.empty())
+		{
+			continue;
+		}
+		size_t eq = define.find('=');
+		std::string macro = define.substr(0, eq);
+		std::string value = eq == std::string::npos ? "1" : define.substr(eq + 1);
+		shaderc_compile_options_add_macro_definition(options, macro.c_str(), macro.size(), value.c_str(), value.size());
+	}
+
+	shaderc_compilation_result_t result = shaderc_compile_into_spv(static_cast<shaderc_compiler_t>(compiler),
+		source.data(), source.size(),
+		stage == ShaderStage::Vertex ? shaderc_vertex_shader : shaderc_fragment_shader,
+		sourcePath.c_str(), "main", options);
+	shaderc_compile_options_release(options);
+
+	if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success)
+	{
+		std::string error = shaderc_result_get_error_message(result);
+		shaderc_result_release(result);
+		throw std::runtime_error("failed to compile " + sourcePath + ":\n" + error);
+	}
+
+	// Unique temp name: two threads may compile the same source at once
+	std::string tmpPath = spvPath + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		out.write(shaderc_result_get_bytes(result), shaderc_result_get_length(result));
+	}
+	shaderc_result_release(result);
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, spvPath, ec);
+	if (ec)
+	{
+		std::filesystem::remove(tmpPath, ec);
+		if (!std::filesystem::exists(spvPath))
+		{
+			throw std::runtime_error("failed to write shader cache entry " + spvPath);
+		}
+	}
+
+	compiled++;
+	return spvPath;
+#else
+	throw std::runtime_error("runtime shader compilation is not built in (define USE_SHADERC): " + sourcePath);
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <atomic>
+#include <string>
+
+// Compiles GLSL to SPIR-V in process (shaderc, when built with USE_SHADERC).
+// Results are cached on disk under cacheDir, keyed by a hash of source + stage + defines,
+// so a warm start never invokes the compiler.
+class ShaderCompiler
+{
+public:
+	void create(const std::string& cacheDir);
+	void destroy();
+
+	static bool isAvailable();
+
+	// Returns the path of the cached .spv for this source; thread safe
+	std::string compile(const std::string& sourcePath, const std::string& defines);
+
+	unsigned compiledCount() const { return compiled; }
+	unsigned cachedCount() const { return cached; }
+
+private:
+	std::string cacheDir;
+	void* compiler = nullptr;
+	std::atomic<unsigned> compiled{ 0 };
+	std::atomic<unsigned> cached{ 0 };
+};
@@ -0,0 +1,59 @@
+#include "ShaderLibrary.h"
+
+#include <stdexcept>
+
+ShaderId ShaderLibrary::intern(const std::string& path, const std::string& defines)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::string key = path + '|' + defines;
+	auto it = ids.find(key);
+	if (it != ids.end())
+	{
+		return it->second;
+	}
+
+	if (entries.size() >= UINT16_MAX)
+	{
+		throw std::runtime_error("too many shaders!");
+	}
+
+	entries.push_back({ path, defines });
+	ShaderId id = static_cast<ShaderId>(entries.size());
+	ids.emplace(key, id);
+	return id;
+}
+
+std::string ShaderLibrary::getPath(ShaderId id) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entry(id).path;
+}
+
+std::string ShaderLibrary::getDefines(ShaderId id) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entry(id).defines;
+}
+
+bool ShaderLibrary::isSource(ShaderId id) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const std::string& path = entry(id).path;
+	return path.size() < 4 || path.compare(path.size() - 4, 4, ".spv") != 0;
+}
+
+ShaderId ShaderLibrary::count() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return static_cast<ShaderId>(entries.size());
+}
+
+const ShaderLibrary::Entry& ShaderLibrary::entry(ShaderId id) const
+{
+	if (id == 0 || id > entries.size())
+	{
+		throw std::runtime_error("invalid shader id!");
+	}
+	return entries[id - 1];
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+typedef uint16_t ShaderId;
+
+// Interns shader files (plus their preprocessor defines) into small ids so pipeline descriptions
+// stay fixed-size and hashable. Paths ending in .spv are used as-is; anything else is GLSL that
+// is compiled at runtime. Id 0 means "no shader".
+class ShaderLibrary
+{
+public:
+	// defines is a ';' separated list of NAME or NAME=VALUE
+	ShaderId intern(const std::string& path, const std::string& defines = "");
+
+	std::string getPath(ShaderId id) const;
+	std::string getDefines(ShaderId id) const;
+	bool isSource(ShaderId id) const;
+	ShaderId count() const;
+
+private:
+	struct Entry
+	{
+		std::string path;
+		std::string defines;
+	};
+
+	std::deque<Entry> entries;
+	std::unordered_map<std::string, ShaderId> ids;
+	mutable std::mutex mutex;
+
+	const Entry& entry(ShaderId id) const;
+};
@@ -0,0 +1,232 @@
+#include "ShaderModuleCache.h"
+#include "Hash.h"
+#include "HostAllocator.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+void ShaderModuleCache::create(ShaderLibrary* library_, ShaderCompiler* compiler_)
+{
+	library = library_;
+	compiler = compiler_;
+}
+
+void ShaderModuleCache::destroy()
+{
+	for (auto& [handle, module] : modules)
+	{
+		vkDestroyShaderModule(device, module.module, hostCallbacks());
+	}
+	modules.clear();
+	byHash.clear();
+	current.clear();
+	prepared.clear();
+}
+
+VkShaderModule ShaderModuleCache::acquire(ShaderId id)
+{
+	return load(id, true).module;
+}
+
+void ShaderModuleCache::release(VkShaderModule module)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = modules.find(module);
+	if (it != modules.end())
+	{
+		it->second.users--;
+		destroyIfUnused(it->second);
+	}
+}
+
+const ShaderReflection& ShaderModuleCache::reflect(ShaderId id)
+{
+	return load(id, false).reflection;
+}
+
+void ShaderModuleCache::prefetch(ShaderId id)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (current.count(id) != 0 || prepared.count(id) != 0)
+		{
+			return;
+		}
+	}
+
+	Prepared ready = prepare(id);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (current.count(id) == 0)
+	{
+		prepared.emplace(id, std::move(ready));
+	}
+}
+
+// A file rewritten since (hot reload) just doesn't match; that costs a second module, not a wrong one
+bool ShaderModuleCache::sameBytes(const std::string& path, const ShaderBlob& blob)
+{
+	try
+	{
+		ShaderBlob existing(path);
+		return existing.sizeBytes() == blob.sizeBytes() && memcmp(existing.words(), blob.words(), blob.sizeBytes()) == 0;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
+
+ShaderModuleCache::Module& ShaderModuleCache::load(ShaderId id, bool acquiring)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		lookups++;
+
+		auto known = current.find(id);
+		if (known != current.end())
+		{
+			reused++;
+			Module& module = modules.at(known->second);
+			module.users += acquiring ? 1 : 0;
+			return module;
+		}
+	}
+
+	Prepared ready;
+	bool wasPrefetched = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = prepared.find(id);
+		if (it != prepared.end())
+		{
+			ready = std::move(it->second);
+			prepared.erase(it);
+			wasPrefetched = true;
+		}
+	}
+	if (!wasPrefetched)
+	{
+		ready = prepare(id);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Another thread loaded id while this one was preparing it
+	auto known = current.find(id);
+	if (known != current.end())
+	{
+		Module& module = modules.at(known->second);
+		module.users += acquiring ? 1 : 0;
+		return module;
+	}
+
+	// A hash match is only a candidate: the bytes decide. Matches are rare (the same shader under two paths),
+	// so the candidate's file is mapped again rather than its code kept around.
+	auto candidates = byHash.equal_range(ready.hash);
+	for (auto it = candidates.first; it != candidates.second; ++it)
+	{
+		Module& module = modules.at(it->second);
+		if (sameBytes(module.path, ready.blob))
+		{
+			reused++;
+			current[id] = module.module;
+			module.ids++;
+			module.users += acquiring ? 1 : 0;
+			return module;
+		}
+	}
+
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = ready.blob.sizeBytes();
+	createInfo.pCode = ready.blob.words();
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(device, &createInfo, hostCallbacks(), &shaderModule) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create shader module!");
+	}
+
+	created++;
+
+	Module& module = modules[shaderModule];
+	module.module = shaderModule;
+	module.reflection = std::move(ready.reflection);
+	module.hash = ready.hash;
+	module.path = ready.path;
+	module.ids = 1;
+	module.users = acquiring ? 1 : 0;
+	byHash.emplace(ready.hash, shaderModule);
+	current[id] = shaderModule;
+	return module;
+}
+
+// Compiling and hashing happen outside the lock so workers don't serialize on them
+ShaderModuleCache::Prepared ShaderModuleCache::prepare(ShaderId id) const
+{
+	std::string path = library->getPath(id);
+	if (library->isSource(id))
+	{
+		if (compiler == nullptr)
+		{
+			throw std::runtime_error("no shader compiler for " + path);
+		}
+		path = compiler->compile(path, library->getDefines(id));
+	}
+
+	Prepared ready;
+	ready.blob = ShaderBlob(path);
+	ready.path = path;
+	ready.hash = hashBytes(ready.blob.words(), ready.blob.sizeBytes());
+	ready.reflection = reflectSpirv(ready.blob.words(), ready.blob.wordCount());
+	return ready;
+}
+
+void ShaderModuleCache::invalidate(ShaderId id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	prepared.erase(id);
+	auto it = current.find(id);
+	if (it == current.end())
+	{
+		return;
+	}
+	Module& module = modules.at(it->second);
+	current.erase(it);
+	module.ids--;
+	destroyIfUnused(module);
+}
+
+// Pipelines keep working without their modules, so nothing waits for the GPU here; only a build that has
+// acquired the module and not created its pipeline yet still needs it
+void ShaderModuleCache::destroyIfUnused(Module& module)
+{
+	if (module.ids > 0 || module.users > 0)
+	{
+		return;
+	}
+
+	auto candidates = byHash.equal_range(module.hash);
+	for (auto it = candidates.first; it != candidates.second; ++it)
+	{
+		if (it->second == module.module)
+		{
+			byHash.erase(it);
+			break;
+		}
+	}
+	VkShaderModule handle = module.module;
+	vkDestroyShaderModule(device, handle, hostCallbacks());
+	modules.erase(handle);
+}
+
+void ShaderModuleCache::printStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	printf("shader modules: %llu created, %zu alive, %llu of %llu lookups reused an existing module\n",
+		static_cast<unsigned long long>(created), modules.size(), static_cast<unsigned long long>(reused),
+		static_cast<unsigned long long>(lookups));
+}
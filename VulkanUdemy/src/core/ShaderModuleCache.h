@@ -0,0 +1,82 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "ShaderBlob.h"
+#include "ShaderCompiler.h"
+#include "ShaderLibrary.h"
+#include "ShaderReflection.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// One VkShaderModule per distinct SPIR-V content. Pipelines that share a shader (or two paths
+// holding identical bytecode) share the module. A module is destroyed once invalidate() has left no id
+// using it and every acquire() of it has been released; the rest live until destroy().
+class ShaderModuleCache
+{
+public:
+	// compiler turns GLSL entries of the library into SPIR-V; may be null if only .spv is used.
+	// Needs no device, so prefetch() can run while the device is still being created.
+	void create(ShaderLibrary* library, ShaderCompiler* compiler);
+	// Before the first acquire() or reflect()
+	void setDevice(VkDevice device_) { device = device_; }
+	void destroy();
+
+	// Compiles, maps and reflects id now, so its first acquire() only creates the module; thread safe
+	void prefetch(ShaderId id);
+
+	// Thread safe; compiles (GLSL) and maps the file on first use of an id. Release the module once the
+	// pipeline built from it exists.
+	VkShaderModule acquire(ShaderId id);
+	void release(VkShaderModule module);
+	// Bindings, push constants, inputs and spec constants of the current version of id; thread safe.
+	// The reference stays valid until id is invalidated.
+	const ShaderReflection& reflect(ShaderId id);
+	// Forget the content of id so the next acquire() re-reads the file
+	void invalidate(ShaderId id);
+
+	ShaderLibrary& getLibrary() const { return *library; }
+	void printStats() const;
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	ShaderLibrary* library = nullptr;
+	ShaderCompiler* compiler = nullptr;
+
+	struct Module
+	{
+		VkShaderModule module;
+		ShaderReflection reflection;
+		uint64_t hash;
+		std::string path;			// the SPIR-V it was made from, mapped again to compare on a hash match
+		uint32_t ids = 0;			// ids whose current version this is
+		uint32_t users = 0;			// acquire()s not yet released
+	};
+
+	// Read by prefetch(), waiting for a device
+	struct Prepared
+	{
+		ShaderBlob blob;
+		std::string path;
+		uint64_t hash = 0;
+		ShaderReflection reflection;
+	};
+
+	std::unordered_map<ShaderId, VkShaderModule> current;
+	std::unordered_map<VkShaderModule, Module> modules;
+	std::unordered_multimap<uint64_t, VkShaderModule> byHash;
+	std::unordered_map<ShaderId, Prepared> prepared;
+	mutable std::mutex mutex;
+
+	uint64_t lookups = 0;
+	uint64_t reused = 0;
+	uint64_t created = 0;
+
+	// acquiring counts a user before the lock is dropped, so invalidate() can't destroy it in between
+	Module& load(ShaderId id, bool acquiring);
+	Prepared prepare(ShaderId id) const;
+	static bool sameBytes(const std::string& path, const ShaderBlob& blob);
+	// With the mutex held
+	void destroyIfUnused(Module& module);
+};
@@ -0,0 +1,557 @@
+#include "ShaderReflection.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// The subset of the SPIR-V grammar needed for reflection (SPIR-V spec, section 3)
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+enum SpirvOp : uint32_t
+{
+	OpName = 5,
+	OpEntryPoint = 15,
+	OpTypeBool = 20,
+	OpTypeInt = 21,
+	OpTypeFloat = 22,
+	OpTypeVector = 23,
+	OpTypeMatrix = 24,
+	OpTypeImage = 25,
+	OpTypeSampler = 26,
+	OpTypeSampledImage = 27,
+	OpTypeArray = 28,
+	OpTypeRuntimeArray = 29,
+	OpTypeStruct = 30,
+	OpTypePointer = 32,
+	OpConstant = 43,
+	OpSpecConstantTrue = 48,
+	OpSpecConstantFalse = 49,
+	OpSpecConstant = 50,
+	OpVariable = 59,
+	OpDecorate = 71,
+	OpMemberDecorate = 72
+};
+
+enum SpirvDecoration : uint32_t
+{
+	DecorationSpecId = 1,
+	DecorationBlock = 2,
+	DecorationBufferBlock = 3,
+	DecorationArrayStride = 6,
+	DecorationMatrixStride = 7,
+	DecorationBuiltIn = 11,
+	DecorationLocation = 30,
+	DecorationBinding = 33,
+	DecorationDescriptorSet = 34,
+	DecorationOffset = 35
+};
+
+enum SpirvStorageClass : uint32_t
+{
+	StorageUniformConstant = 0,
+	StorageInput = 1,
+	StorageUniform = 2,
+	StoragePushConstant = 9,
+	StorageStorageBuffer = 12
+};
+
+static const uint32_t DIM_BUFFER = 5;
+static const uint32_t DIM_SUBPASS_DATA = 6;
+static const uint32_t IMAGE_SAMPLED_STORAGE = 2;
+
+// Flags in SpirvId::decorations
+static const uint32_t HAS_SET = 1 << 0;
+static const uint32_t HAS_BINDING = 1 << 1;
+static const uint32_t HAS_LOCATION = 1 << 2;
+static const uint32_t HAS_SPEC_ID = 1 << 3;
+static const uint32_t IS_BLOCK = 1 << 4;
+static const uint32_t IS_BUFFER_BLOCK = 1 << 5;
+static const uint32_t IS_BUILTIN = 1 << 6;
+
+// Everything the module says about one result id
+struct SpirvId
+{
+	uint32_t opcode = 0;
+	uint32_t typeId = 0;		// pointee, element, component, column or result type
+	uint32_t storageClass = 0;
+	uint32_t width = 0;
+	uint32_t signedness = 0;
+	uint32_t count = 0;			// vector components, matrix columns; array length constant id
+	uint32_t imageDim = 0;
+	uint32_t imageSampled = 0;
+	uint32_t value = 0;			// constants
+
+	uint32_t decorations = 0;
+	uint32_t set = 0;
+	uint32_t binding = 0;
+	uint32_t location = 0;
+	uint32_t specId = 0;
+	uint32_t arrayStride = 0;
+
+	std::vector<uint32_t> members;
+	std::vector<uint32_t> memberOffsets;
+	std::vector<uint32_t> memberMatrixStrides;
+
+	std::string name;
+};
+
+// Every id operand comes from the module, so it is checked against the id bound before use
+static const SpirvId& lookup(const std::vector<SpirvId>& ids, uint32_t index)
+{
+	if (index >= ids.size())
+	{
+		throw std::runtime_error("SPIR-V id out of bounds!");
+	}
+	return ids[index];
+}
+
+// Words an instruction needs for the operands read below, opcode word included
+static uint32_t minimumLength(uint32_t opcode)
+{
+	switch (opcode)
+	{
+	case OpName: return 3;
+	case OpEntryPoint: return 4;
+	case OpDecorate: return 3;
+	case OpMemberDecorate: return 4;
+	case OpTypeBool:
+	case OpTypeSampler:
+	case OpTypeStruct: return 2;
+	case OpTypeFloat:
+	case OpTypeRuntimeArray:
+	case OpTypeSampledImage:
+	case OpSpecConstantTrue:
+	case OpSpecConstantFalse: return 3;
+	case OpTypeInt:
+	case OpTypeVector:
+	case OpTypeMatrix:
+	case OpTypeArray:
+	case OpTypePointer:
+	case OpConstant:
+	case OpSpecConstant:
+	case OpVariable: return 4;
+	case OpTypeImage: return 9;
+	}
+	return 1;
+}
+
+// Types can't contain themselves in valid SPIR-V; a malformed module could loop forever without a limit
+static const uint32_t MAX_TYPE_DEPTH = 64;
+
+static std::string readString(const uint32_t* words, uint32_t wordCount)
+{
+	const char* chars = reinterpret_cast<const char*>(words);
+	size_t maxLength = wordCount * sizeof(uint32_t);
+	size_t length = 0;
+	while (length < maxLength && chars[length] != '\0')
+	{
+		length++;
+	}
+	return std::string(chars, length);
+}
+
+static VkShaderStageFlags stageFromExecutionModel(uint32_t model)
+{
+	switch (model)
+	{
+	case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+	case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+	case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+	case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+	case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+	case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	throw std::runtime_error("unsupported shader execution model!");
+}
+
+static void setMember(std::vector<uint32_t>& values, uint32_t member, uint32_t value)
+{
+	if (values.size() <= member)
+	{
+		values.resize(member + 1, 0);
+	}
+	values[member] = value;
+}
+
+// Byte size of a type in an explicitly laid out block (push constants)
+static uint32_t typeSize(const std::vector<SpirvId>& ids, uint32_t typeId, uint32_t matrixStride, uint32_t depth = 0)
+{
+	if (depth > MAX_TYPE_DEPTH)
+	{
+		throw std::runtime_error("SPIR-V types nested too deeply!");
+	}
+	const SpirvId& type = lookup(ids, typeId);
+	switch (type.opcode)
+	{
+	case OpTypeBool:
+		return 4;
+	case OpTypeInt:
+	case OpTypeFloat:
+		return type.width / 8;
+	case OpTypeVector:
+		return type.count * typeSize(ids, type.typeId, 0, depth + 1);
+	case OpTypeMatrix:
+		return type.count * (matrixStride > 0 ? matrixStride : typeSize(ids, type.typeId, 0, depth + 1));
+	case OpTypeArray:
+	{
+		uint32_t length = lookup(ids, type.count).value;
+		uint32_t stride = type.arrayStride > 0 ? type.arrayStride : typeSize(ids, type.typeId, matrixStride, depth + 1);
+		return length * stride;
+	}
+	case OpTypeRuntimeArray:
+		return 0;
+	case OpTypeStruct:
+	{
+		uint32_t size = 0;
+		for (size_t m = 0; m < type.members.size(); m++)
+		{
+			uint32_t offset = m < type.memberOffsets.size() ? type.memberOffsets[m] : 0;
+			uint32_t stride = m < type.memberMatrixStrides.size() ? type.memberMatrixStrides[m] : 0;
+			size = std::max(size, offset + typeSize(ids, type.members[m], stride, depth + 1));
+		}
+		return size;
+	}
+	}
+	throw std::runtime_error("unsupported type in shader block!");
+}
+
+static VkDescriptorType descriptorType(const std::vector<SpirvId>& ids, uint32_t typeId, uint32_t storageClass)
+{
+	const SpirvId& type = lookup(ids, typeId);
+	if (storageClass == StorageStorageBuffer)
+	{
+		return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	}
+	if (storageClass == StorageUniform)
+	{
+		return (type.decorations & IS_BUFFER_BLOCK) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	}
+
+	switch (type.opcode)
+	{
+	case OpTypeSampler:
+		return VK_DESCRIPTOR_TYPE_SAMPLER;
+	case OpTypeSampledImage:
+		return lookup(ids, type.typeId).imageDim == DIM_BUFFER ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	case OpTypeImage:
+		if (type.imageDim == DIM_BUFFER)
+		{
+			return type.imageSampled == IMAGE_SAMPLED_STORAGE ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+		}
+		if (type.imageDim == DIM_SUBPASS_DATA)
+		{
+			return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		}
+		return type.imageSampled == IMAGE_SAMPLED_STORAGE ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	}
+	throw std::runtime_error("unsupported descriptor type in shader!");
+}
+
+static VkFormat vertexFormat(const std::vector<SpirvId>& ids, uint32_t typeId)
+{
+	const SpirvId* type = &lookup(ids, typeId);
+	uint32_t components = 1;
+	if (type->opcode == OpTypeVector)
+	{
+		components = type->count;
+		type = &lookup(ids, type->typeId);
+	}
+	if (type->width != 32 || components < 1 || components > 4)
+	{
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	static const VkFormat floats[4] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+	static const VkFormat ints[4] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+	static const VkFormat uints[4] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+	if (type->opcode == OpTypeFloat)
+	{
+		return floats[components - 1];
+	}
+	if (type->opcode == OpTypeInt)
+	{
+		return type->signedness ? ints[components - 1] : uints[components - 1];
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
+const ReflectedSpecConstant* ShaderReflection::findSpecConstant(const std::string& name) const
+{
+	for (const ReflectedSpecConstant& constant : specConstants)
+	{
+		if (constant.name == name)
+		{
+			return &constant;
+		}
+	}
+	return nullptr;
+}
+
+ShaderReflection reflectSpirv(const uint32_t* words, size_t wordCount)
+{
+	if (wordCount < 5 || words[0] != SPIRV_MAGIC)
+	{
+		throw std::runtime_error("not a SPIR-V module!");
+	}
+
+	uint32_t bound = words[3];
+	std::vector<SpirvId> ids(bound);
+	auto id = [&](uint32_t index) -> SpirvId&
+	{
+		if (index >= bound)
+		{
+			throw std::runtime_error("SPIR-V id out of bounds!");
+		}
+		return ids[index];
+	};
+
+	ShaderReflection reflection;
+
+	size_t i = 5;
+	while (i < wordCount)
+	{
+		const uint32_t* op = words + i;
+		uint32_t length = op[0] >> 16;
+		uint32_t opcode = op[0] & 0xffff;
+		if (length < minimumLength(opcode) || i + length > wordCount)
+		{
+			throw std::runtime_error("malformed SPIR-V instruction!");
+		}
+
+		switch (opcode)
+		{
+		case OpName:
+			id(op[1]).name = readString(op + 2, length - 2);
+			break;
+		case OpEntryPoint:
+			reflection.stages |= stageFromExecutionModel(op[1]);
+			break;
+		case OpDecorate:
+		{
+			SpirvId& target = id(op[1]);
+			uint32_t literal = length > 3 ? op[3] : 0;
+			switch (op[2])
+			{
+			case DecorationSpecId: target.specId = literal; target.decorations |= HAS_SPEC_ID; break;
+			case DecorationBlock: target.decorations |= IS_BLOCK; break;
+			case DecorationBufferBlock: target.decorations |= IS_BUFFER_BLOCK; break;
+			case DecorationArrayStride: target.arrayStride = literal; break;
+			case DecorationBuiltIn: target.decorations |= IS_BUILTIN; break;
+			case DecorationLocation: target.location = literal; target.decorations |= HAS_LOCATION; break;
+			case DecorationBinding: target.binding = literal; target.decorations |= HAS_BINDING; break;
+			case DecorationDescriptorSet: target.set = literal; target.decorations |= HAS_SET; break;
+			}
+			break;
+		}
+		case OpMemberDecorate:
+		{
+			SpirvId& target = id(op[1]);
+			uint32_t literal = length > 4 ? op[4] : 0;
+			if (op[3] == DecorationOffset)
+			{
+				setMember(target.memberOffsets, op[2], literal);
+			}
+			else if (op[3] == DecorationMatrixStride)
+			{
+				setMember(target.memberMatrixStrides, op[2], literal);
+			}
+			break;
+		}
+		case OpTypeBool:
+		case OpTypeSampler:
+			id(op[1]).opcode = opcode;
+			break;
+		case OpTypeInt:
+			id(op[1]).opcode = opcode;
+			ids[op[1]].width = op[2];
+			ids[op[1]].signedness = op[3];
+			break;
+		case OpTypeFloat:
+			id(op[1]).opcode = opcode;
+			ids[op[1]].width = op[2];
+			break;
+		case OpTypeVector:
+		case OpTypeMatrix:
+		case OpTypeArray:
+			id(op[1]).opcode = opcode;
+			ids[op[1]].typeId = op[2];
+			ids[op[1]].count = op[3];
+			break;
+		case OpTypeRuntimeArray:
+		case OpTypeSampledImage:
+			id(op[1]).opcode = opcode;
+			ids[op[1]].typeId = op[2];
+			break;
+		case OpTypeImage:
+			id(op[1]).opcode = opcode;
+			ids[op[1]].typeId = op[2];
+			ids[op[1]].imageDim = op[3];
+			ids[op[1]].imageSampled = op[7];
+			break;
+		case OpTypeStruct:
+			id(op[1]).opcode = opcode;
+			ids[op[1]].members.assign(op + 2, op + length);
+			break;
+		case OpTypePointer:
+			id(op[1]).opcode = opcode;
+			ids[op[1]].storageClass = op[2];
+			ids[op[1]].typeId = op[3];
+			break;
+		case OpConstant:
+		case OpSpecConstant:
+			id(op[2]).opcode = opcode;
+			ids[op[2]].typeId = op[1];
+			ids[op[2]].value = op[3];
+			break;
+		case OpSpecConstantTrue:
+		case OpSpecConstantFalse:
+			id(op[2]).opcode = opcode;
+			ids[op[2]].typeId = op[1];
+			ids[op[2]].value = opcode == OpSpecConstantTrue ? 1 : 0;
+			break;
+		case OpVariable:
+			id(op[2]).opcode = opcode;
+			ids[op[2]].typeId = op[1];
+			ids[op[2]].storageClass = op[3];
+			break;
+		}
+
+		i += length;
+	}
+
+	for (uint32_t v = 0; v < bound; v++)
+	{
+		const SpirvId& var = ids[v];
+
+		if ((var.opcode == OpSpecConstant || var.opcode == OpSpecConstantTrue || var.opcode == OpSpecConstantFalse) && (var.decorations & HAS_SPEC_ID))
+		{
+			ReflectedSpecConstant constant;
+			constant.constantId = var.specId;
+			const SpirvId& type = id(var.typeId);
+			constant.type = type.opcode == OpTypeBool ? SpecConstantType::Bool :
+				type.opcode == OpTypeFloat ? SpecConstantType::Float :
+				type.signedness ? SpecConstantType::Int : SpecConstantType::UInt;
+			constant.size = typeSize(ids, var.typeId, 0);
+			constant.defaultValue = var.value;
+			constant.name = var.name;
+			reflection.specConstants.push_back(constant);
+			continue;
+		}
+
+		if (var.opcode != OpVariable)
+		{
+			continue;
+		}
+
+		uint32_t typeId = id(var.typeId).typeId;
+		switch (var.storageClass)
+		{
+		case StorageUniformConstant:
+		case StorageUniform:
+		case StorageStorageBuffer:
+		{
+			if (!(var.decorations & HAS_BINDING))
+			{
+				continue;
+			}
+
+			ReflectedBinding binding;
+			binding.set = var.set;
+			binding.binding = var.binding;
+			binding.stages = reflection.stages;
+			for (uint32_t depth = 0; id(typeId).opcode == OpTypeArray || id(typeId).opcode == OpTypeRuntimeArray; depth++)
+			{
+				if (id(typeId).opcode == OpTypeRuntimeArray)
+				{
+					throw std::runtime_error("unsized descriptor arrays are not supported: " + var.name);
+				}
+				if (depth > MAX_TYPE_DEPTH)
+				{
+					throw std::runtime_error("SPIR-V types nested too deeply!");
+				}
+				binding.count *= id(id(typeId).count).value;
+				typeId = id(typeId).typeId;
+			}
+			binding.type = descriptorType(ids, typeId, var.storageClass);
+			// Blocks usually have an empty instance name; the block type carries the useful one
+			binding.name = var.name.empty() ? id(typeId).name : var.name;
+			reflection.bindings.push_back(binding);
+			break;
+		}
+		case StoragePushConstant:
+			reflection.pushConstantStages = reflection.stages;
+			reflection.pushConstantSize = std::max(reflection.pushConstantSize, typeSize(ids, typeId, 0));
+			break;
+		case StorageInput:
+			if ((reflection.stages & VK_SHADER_STAGE_VERTEX_BIT) && (var.decorations & HAS_LOCATION) && !(var.decorations & IS_BUILTIN))
+			{
+				ReflectedVertexInput input;
+				input.location = var.location;
+				input.format = vertexFormat(ids, typeId);
+				input.name = var.name;
+				reflection.vertexInputs.push_back(input);
+			}
+			break;
+		}
+	}
+
+	std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b)
+		{ return a.set != b.set ? a.set < b.set : a.binding < b.binding; });
+	std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(), [](const ReflectedVertexInput& a, const ReflectedVertexInput& b)
+		{ return a.location < b.location; });
+	std::sort(reflection.specConstants.begin(), reflection.specConstants.end(), [](const ReflectedSpecConstant& a, const ReflectedSpecConstant& b)
+		{ return a.constantId < b.constantId; });
+
+	return reflection;
+}
+
+ShaderReflection mergeReflection(const ShaderReflection& a, const ShaderReflection& b)
+{
+	ShaderReflection merged = a;
+	merged.stages |= b.stages;
+
+	for (const ReflectedBinding& binding : b.bindings)
+	{
+		auto it = std::find_if(merged.bindings.begin(), merged.bindings.end(), [&](const ReflectedBinding& existing)
+			{ return existing.set == binding.set && existing.binding == binding.binding; });
+		if (it == merged.bindings.end())
+		{
+			merged.bindings.push_back(binding);
+		}
+		else if (it->type != binding.type || it->count != binding.count)
+		{
+			throw std::runtime_error("set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) + " is declared differently across shader stages!");
+		}
+		else
+		{
+			it->stages |= binding.stages;
+		}
+	}
+
+	if (b.pushConstantSize > 0)
+	{
+		merged.pushConstantStages |= b.pushConstantStages;
+		merged.pushConstantSize = std::max(merged.pushConstantSize, b.pushConstantSize);
+	}
+
+	merged.vertexInputs.insert(merged.vertexInputs.end(), b.vertexInputs.begin(), b.vertexInputs.end());
+
+	for (const ReflectedSpecConstant& constant : b.specConstants)
+	{
+		auto it = std::find_if(merged.specConstants.begin(), merged.specConstants.end(), [&](const ReflectedSpecConstant& existing)
+			{ return existing.constantId == constant.constantId; });
+		if (it == merged.specConstants.end())
+		{
+			merged.specConstants.push_back(constant);
+		}
+	}
+
+	std::sort(merged.bindings.begin(), merged.bindings.end(), [](const ReflectedBinding& x, const ReflectedBinding& y)
+		{ return x.set != y.set ? x.set < y.set : x.binding < y.binding; });
+	std::sort(merged.vertexInputs.begin(), merged.vertexInputs.end(), [](const ReflectedVertexInput& x, const ReflectedVertexInput& y)
+		{ return x.location < y.location; });
+	std::sort(merged.specConstants.begin(), merged.specConstants.end(), [](const ReflectedSpecConstant& x, const ReflectedSpecConstant& y)
+		{ return x.constantId < y.constantId; });
+
+	return merged;
+}
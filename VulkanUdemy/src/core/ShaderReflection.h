@@ -0,0 +1,58 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+struct ReflectedBinding
+{
+	uint32_t set = 0;
+	uint32_t binding = 0;
+	VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uint32_t count = 1;
+	VkShaderStageFlags stages = 0;
+	std::string name;
+};
+
+struct ReflectedVertexInput
+{
+	uint32_t location = 0;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	std::string name;
+};
+
+enum class SpecConstantType
+{
+	Bool,
+	Int,
+	UInt,
+	Float
+};
+
+struct ReflectedSpecConstant
+{
+	uint32_t constantId = 0;
+	SpecConstantType type = SpecConstantType::Int;
+	uint32_t size = 4;
+	uint32_t defaultValue = 0;	// raw bits; bools are 0/1
+	std::string name;
+};
+
+// What a shader (or a merged set of stages) expects from its pipeline
+struct ShaderReflection
+{
+	VkShaderStageFlags stages = 0;
+	std::vector<ReflectedBinding> bindings;			// sorted by set, then binding
+	VkShaderStageFlags pushConstantStages = 0;
+	uint32_t pushConstantSize = 0;
+	std::vector<ReflectedVertexInput> vertexInputs;	// sorted by location
+	std::vector<ReflectedSpecConstant> specConstants;	// sorted by constant id
+
+	const ReflectedSpecConstant* findSpecConstant(const std::string& name) const;
+};
+
+// Parses a SPIR-V module's decorations and types; throws on malformed input
+ShaderReflection reflectSpirv(const uint32_t* words, size_t wordCount);
+
+// Combines the stages of one pipeline; a set/binding declared by several stages must agree on type and count
+ShaderReflection mergeReflection(const ShaderReflection& a, const ShaderReflection& b);
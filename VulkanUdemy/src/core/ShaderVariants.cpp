@@ -0,0 +1,130 @@
+#include "ShaderVariants.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+static std::string bytecodePath(const std::filesystem::path& dir, const std::string& source)
+{
+	return (dir / "bytecodes" / std::filesystem::path(source).stem()).generic_string() + ".spv";
+}
+
+static uint32_t parseValue(const ShaderVariant& variant, const ReflectedSpecConstant& constant, const std::string& text)
+{
+	try
+	{
+		switch (constant.type)
+		{
+		case SpecConstantType::Bool:
+			if (text == "true" || text == "1")
+			{
+				return 1;
+			}
+			if (text == "false" || text == "0")
+			{
+				return 0;
+			}
+			break;
+		case SpecConstantType::Int:
+			return static_cast<uint32_t>(std::stoi(text));
+		case SpecConstantType::UInt:
+			return static_cast<uint32_t>(std::stoul(text));
+		case SpecConstantType::Float:
+		{
+			float f = std::stof(text);
+			uint32_t bits;
+			memcpy(&bits, &f, sizeof(bits));
+			return bits;
+		}
+		}
+	}
+	catch (const std::exception&)
+	{
+	}
+	throw std::runtime_error("variant " + variant.name + ": bad value '" + text + "' for " + constant.name);
+}
+
+std::vector<ShaderVariant> loadVariantManifest(const std::string& path)
+{
+	std::vector<ShaderVariant> variants;
+
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		return variants;
+	}
+	std::filesystem::path dir = std::filesystem::path(path).parent_path();
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream tokens(line);
+		ShaderVariant variant;
+		if (!(tokens >> variant.name))
+		{
+			continue;
+		}
+
+		std::string vert, frag;
+		if (!(tokens >> vert >> frag))
+		{
+			throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected name, vertex and fragment shader");
+		}
+		variant.vertSource = (dir / vert).generic_string();
+		variant.fragSource = (dir / frag).generic_string();
+		variant.vertBytecode = bytecodePath(dir, vert);
+		variant.fragBytecode = bytecodePath(dir, frag);
+
+		std::string assignment;
+		while (tokens >> assignment)
+		{
+			size_t eq = assignment.find('=');
+			if (eq == std::string::npos || eq == 0)
+			{
+				throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected CONSTANT=value, got " + assignment);
+			}
+			variant.constants.push_back({ assignment.substr(0, eq), assignment.substr(eq + 1) });
+		}
+
+		variants.push_back(variant);
+	}
+
+	return variants;
+}
+
+SpecializationDesc specializeVariant(const ShaderVariant& variant, const ShaderReflection& reflection)
+{
+	SpecializationDesc spec;
+	for (const ShaderVariantConstant& c : variant.constants)
+	{
+		const ReflectedSpecConstant* constant = reflection.findSpecConstant(c.name);
+		if (constant == nullptr && !c.name.empty() && c.name.find_first_not_of("0123456789") == std::string::npos)
+		{
+			uint32_t id = static_cast<uint32_t>(std::stoul(c.name));
+			for (const ReflectedSpecConstant& candidate : reflection.specConstants)
+			{
+				if (candidate.constantId == id)
+				{
+					constant = &candidate;
+				}
+			}
+		}
+		if (constant == nullptr)
+		{
+			throw std::runtime_error("variant " + variant.name + ": shaders have no specialization constant " + c.name);
+		}
+		if (constant->size != sizeof(uint32_t))
+		{
+			throw std::runtime_error("variant " + variant.name + ": only 32-bit specialization constants are supported (" + c.name + ")");
+		}
+
+		spec.set(constant->constantId, parseValue(variant, *constant, c.value));
+	}
+	return spec;
+}
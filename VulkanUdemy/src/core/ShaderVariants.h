@@ -0,0 +1,31 @@
+#pragma once
+#include "PipelineDesc.h"
+#include "ShaderReflection.h"
+
+#include <string>
+#include <vector>
+
+struct ShaderVariantConstant
+{
+	std::string name;	// specialization constant name, or its numeric constant_id
+	std::string value;
+};
+
+// One line of the variant manifest: a shader pair plus the constants to specialize it with
+struct ShaderVariant
+{
+	std::string name;
+	std::string vertSource;
+	std::string fragSource;
+	std::string vertBytecode;	// offline-compiled fallback: bytecodes/<stem>.spv next to the manifest
+	std::string fragBytecode;
+	std::vector<ShaderVariantConstant> constants;
+};
+
+// Format, one variant per line ('#' starts a comment, paths relative to the manifest):
+//   name  vertex.glsl  fragment.glsl  [CONSTANT=value ...]
+// A missing manifest means no variants; malformed lines throw.
+std::vector<ShaderVariant> loadVariantManifest(const std::string& path);
+
+// Resolves the variant's constants against the pipeline's reflected specialization constants
+SpecializationDesc specializeVariant(const ShaderVariant& variant, const ShaderReflection& reflection);
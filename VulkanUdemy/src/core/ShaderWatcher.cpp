@@ -0,0 +1,42 @@
+#include "ShaderWatcher.h"
+
+void ShaderWatcher::watch(ShaderId id, const std::string& path)
+{
+	for (const Watched& w : files)
+	{
+		if (w.id == id)
+		{
+			return;
+		}
+	}
+
+	std::error_code ec;
+	auto lastWrite = std::filesystem::last_write_time(path, ec);
+	files.push_back({ id, path, lastWrite });
+}
+
+std::vector<ShaderId> ShaderWatcher::poll(std::chrono::milliseconds interval)
+{
+	std::vector<ShaderId> changed;
+
+	auto now = std::chrono::steady_clock::now();
+	if (now - lastPoll < interval)
+	{
+		return changed;
+	}
+	lastPoll = now;
+
+	for (Watched& w : files)
+	{
+		// Editors briefly delete/rename while saving; just try again next poll
+		std::error_code ec;
+		auto lastWrite = std::filesystem::last_write_time(w.path, ec);
+		if (!ec && lastWrite != w.lastWrite)
+		{
+			w.lastWrite = lastWrite;
+			changed.push_back(w.id);
+		}
+	}
+
+	return changed;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "ShaderLibrary.h"
+
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+// Polls the modification time of GLSL sources so edited shaders can be rebuilt while running
+class ShaderWatcher
+{
+public:
+	void watch(ShaderId id, const std::string& path);
+
+	// Returns the shaders whose file changed since the last call; stats at most once per interval
+	std::vector<ShaderId> poll(std::chrono::milliseconds interval = std::chrono::milliseconds(250));
+
+private:
+	struct Watched
+	{
+		ShaderId id;
+		std::filesystem::path path;
+		std::filesystem::file_time_type lastWrite;
+	};
+
+	std::vector<Watched> files;
+	std::chrono::steady_clock::time_point lastPoll;
+};
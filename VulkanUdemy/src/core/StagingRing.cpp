@@ -0,0 +1,568 @@
+#include "StagingRing.h"
+#include "HostAllocator.h"
+#include "VulkanDispatch.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// Keeps every copy source valid for vkCmdCopyBufferToImage (a multiple of 4 and of the texel size)
+static const VkDeviceSize RING_ALIGNMENT = 16;
+
+void StagingRing::create(DeviceAllocator* allocator_, VkQueue queue_, uint32_t queueFamily, VkDeviceSize capacity_,
+	VkQueue transferQueue_, uint32_t transferFamily_, uint32_t framesInFlight_)
+{
+	allocator = allocator_;
+	device = allocator->getDevice();
+	queue = queue_;
+	capacity = capacity_;
+	graphicsFamily = queueFamily;
+	transferFamily = transferFamily_;
+	framesInFlight = framesInFlight_;
+	transferQueue = transferFamily != graphicsFamily ? transferQueue_ : VK_NULL_HANDLE;
+
+	allocator->createBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+	mapped = static_cast<char*>(memory.mapped);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	if (vkCreateCommandPool(device, &poolInfo, hostCallbacks(), &commandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create staging command pool!");
+	}
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+	if (vkAllocateCommandBuffers(device, &allocInfo, &flushCommandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate staging command buffer!");
+	}
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (vkCreateFence(device, &fenceInfo, hostCallbacks(), &flushFence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create staging fence!");
+	}
+
+	if (transferQueue != VK_NULL_HANDLE)
+	{
+		createTransferResources();
+	}
+}
+
+void StagingRing::createTransferResources()
+{
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = transferFamily;
+	if (vkCreateCommandPool(device, &poolInfo, hostCallbacks(), &transferPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create transfer command pool!");
+	}
+
+	transferCommandBuffers.resize(framesInFlight);
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = transferPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = framesInFlight;
+	if (vkAllocateCommandBuffers(device, &allocInfo, transferCommandBuffers.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate transfer command buffers!");
+	}
+
+	transferSemaphores.resize(framesInFlight);
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	for (VkSemaphore& semaphore : transferSemaphores)
+	{
+		if (vkCreateSemaphore(device, &semaphoreInfo, hostCallbacks(), &semaphore) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create transfer semaphore!");
+		}
+	}
+
+	// Busy time needs timestamps on the transfer family
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(allocator->getPhysicalDevice(), &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(allocator->getPhysicalDevice(), &familyCount, families.data());
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(allocator->getPhysicalDevice(), &properties);
+	if (families[transferFamily].timestampValidBits == 0)
+	{
+		return;
+	}
+	timestampPeriod = properties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryInfo{};
+	queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryInfo.queryCount = 2 * framesInFlight * 2;
+	if (vkCreateQueryPool(device, &queryInfo, hostCallbacks(), &queryPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create timestamp query pool!");
+	}
+	setHasTransfer.assign(2 * framesInFlight, false);
+
+	// Every set starts reset; after that frames reset them ahead of use
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkd().vkBeginCommandBuffer(flushCommandBuffer, &beginInfo);
+	vkd().vkCmdResetQueryPool(flushCommandBuffer, queryPool, 0, queryInfo.queryCount);
+	vkd().vkEndCommandBuffer(flushCommandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &flushCommandBuffer;
+	if (vkd().vkQueueSubmit(queue, 1, &submitInfo, flushFence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to submit query reset!");
+	}
+	vkd().vkWaitForFences(device, 1, &flushFence, VK_TRUE, UINT64_MAX);
+	vkd().vkResetFences(device, 1, &flushFence);
+	vkd().vkResetCommandBuffer(flushCommandBuffer, 0);
+}
+
+void StagingRing::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	if (queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, queryPool, hostCallbacks());
+		queryPool = VK_NULL_HANDLE;
+	}
+	for (VkSemaphore semaphore : transferSemaphores)
+	{
+		vkDestroySemaphore(device, semaphore, hostCallbacks());
+	}
+	transferSemaphores.clear();
+	transferCommandBuffers.clear();
+	if (transferPool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(device, transferPool, hostCallbacks());
+		transferPool = VK_NULL_HANDLE;
+	}
+
+	vkDestroyFence(device, flushFence, hostCallbacks());
+	vkDestroyCommandPool(device, commandPool, hostCallbacks());
+	allocator->destroyBuffer(buffer, memory);
+
+	bufferCopies.clear();
+	imageCopies.clear();
+	frames.clear();
+	device = VK_NULL_HANDLE;
+}
+
+void StagingRing::uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	const char* bytes = static_cast<const char*>(data);
+	for (VkDeviceSize done = 0; done < size;)
+	{
+		VkDeviceSize chunk = std::min(size - done, capacity);
+		VkDeviceSize offset = reserve(chunk);
+		memcpy(mapped + offset, bytes + done, static_cast<size_t>(chunk));
+
+		// Back-to-back uploads into one buffer become a single region
+		if (!bufferCopies.empty())
+		{
+			BufferCopy& last = bufferCopies.back();
+			if (last.dst == dst && last.region.srcOffset + last.region.size == offset && last.region.dstOffset + last.region.size == dstOffset + done)
+			{
+				last.region.size += chunk;
+				done += chunk;
+				continue;
+			}
+		}
+
+		bufferCopies.push_back({ dst, { offset, dstOffset + done, chunk } });
+		done += chunk;
+	}
+
+	stats.uploads++;
+	stats.bytes += size;
+}
+
+void StagingRing::uploadImage(VkImage dst, const VkBufferImageCopy& region, VkImageLayout oldLayout, VkImageLayout newLayout,
+	VkImageAspectFlags aspect, const void* data, VkDeviceSize size)
+{
+	if (size > capacity)
+	{
+		throw std::runtime_error("image upload is larger than the staging ring!");
+	}
+	if (transferQueue != VK_NULL_HANDLE && oldLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+	{
+		throw std::runtime_error("transfer-queue image uploads must start from VK_IMAGE_LAYOUT_UNDEFINED!");
+	}
+
+	VkDeviceSize offset = reserve(size);
+	memcpy(mapped + offset, data, static_cast<size_t>(size));
+
+	ImageCopy copy{ dst, region, oldLayout, newLayout, aspect };
+	copy.region.bufferOffset = offset;
+	copy.region.bufferRowLength = 0;
+	copy.region.bufferImageHeight = 0;
+	imageCopies.push_back(copy);
+
+	stats.uploads++;
+	stats.bytes += size;
+}
+
+VkSemaphore StagingRing::submit()
+{
+	if (transferQueue == VK_NULL_HANDLE || !hasPending())
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	// This slot's previous batch was waited on by the frame whose fence update() just saw
+	uint32_t slot = static_cast<uint32_t>(frameNumber % framesInFlight);
+	VkCommandBuffer commandBuffer = transferCommandBuffers[slot];
+	vkd().vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkd().vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	if (queryPool != VK_NULL_HANDLE)
+	{
+		vkd().vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, querySet(frameNumber));
+		setHasTransfer[querySet(frameNumber) / 2] = true;
+	}
+	recordCopies(commandBuffer, true);
+	if (queryPool != VK_NULL_HANDLE)
+	{
+		vkd().vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, querySet(frameNumber) + 1);
+	}
+	vkd().vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &transferSemaphores[slot];
+	if (vkd().vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to submit transfer batch!");
+	}
+
+	frames.push_back({ frameNumber, head });
+	stats.transferBatches++;
+	return transferSemaphores[slot];
+}
+
+void StagingRing::record(VkCommandBuffer commandBuffer)
+{
+	if (queryPool != VK_NULL_HANDLE)
+	{
+		vkd().vkCmdResetQueryPool(commandBuffer, queryPool, querySet(frameNumber + framesInFlight), 2);
+	}
+
+	if (!bufferAcquires.empty() || !imageAcquires.empty())
+	{
+		// The semaphore wait covered the transfer; these take ownership on this family
+		vkd().vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+			static_cast<uint32_t>(bufferAcquires.size()), bufferAcquires.data(), static_cast<uint32_t>(imageAcquires.size()), imageAcquires.data());
+		bufferAcquires.clear();
+		imageAcquires.clear();
+	}
+
+	// Copies queued after submit() (or with no transfer queue at all) go on this command buffer
+	if (hasPending())
+	{
+		recordCopies(commandBuffer, false);
+		frames.push_back({ frameNumber, head });
+	}
+}
+
+void StagingRing::update(uint64_t frameNumber_, uint32_t framesInFlight)
+{
+	frameNumber = frameNumber_;
+
+	if (queryPool != VK_NULL_HANDLE && frameNumber >= framesInFlight)
+	{
+		readTimestamps(frameNumber - framesInFlight);
+	}
+
+	while (!frames.empty() && frameNumber >= frames.front().frameNumber + framesInFlight)
+	{
+		tail = frames.front().end;
+		frames.pop_front();
+	}
+}
+
+void StagingRing::flush()
+{
+	if (!hasPending())
+	{
+		return;
+	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkd().vkBeginCommandBuffer(flushCommandBuffer, &beginInfo);
+	recordCopies(flushCommandBuffer, false);
+	vkd().vkEndCommandBuffer(flushCommandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &flushCommandBuffer;
+	if (vkd().vkQueueSubmit(queue, 1, &submitInfo, flushFence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to submit staging copies!");
+	}
+	vkd().vkWaitForFences(device, 1, &flushFence, VK_TRUE, UINT64_MAX);
+	vkd().vkResetFences(device, 1, &flushFence);
+	vkd().vkResetCommandBuffer(flushCommandBuffer, 0);
+
+	// The fence also covers every frame submitted to this queue before it (and the transfer batches they waited on)
+	tail = head;
+	frames.clear();
+	stats.flushes++;
+}
+
+void StagingRing::printStats() const
+{
+	const double MB = 1024.0 * 1024.0;
+
+	printf("staging ring (%.0f MB): %u uploads, %.2f MB, %u copy commands for %u regions, %u flushes, %u stalls\n",
+		capacity / MB, stats.uploads, stats.bytes / MB, stats.copyCommands, stats.regions, stats.flushes, stats.stalls);
+	if (transferQueue == VK_NULL_HANDLE)
+	{
+		printf("  uploads run on the graphics queue\n");
+	}
+	else if (queryPool == VK_NULL_HANDLE)
+	{
+		printf("  transfer queue (family %u): %u batches, no timestamps on this family\n", transferFamily, stats.transferBatches);
+	}
+	else
+	{
+		printf("  transfer queue (family %u): %u batches, %.2f ms busy\n", transferFamily, stats.transferBatches, stats.transferMs);
+	}
+}
+
+VkDeviceSize StagingRing::reserve(VkDeviceSize size)
+{
+	uint64_t position = (head + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+	// Never straddle the end of the buffer; skip to the start instead
+	if (position % capacity + size > capacity)
+	{
+		position += capacity - position % capacity;
+	}
+
+	if (position + size - tail > capacity)
+	{
+		// Full of data frames in flight (or our own queued copies) still need: push it all through and start over
+		stats.stalls++;
+		flush();
+		vkQueueWaitIdle(queue);
+		if (transferQueue != VK_NULL_HANDLE)
+		{
+			vkQueueWaitIdle(transferQueue);
+		}
+		head = 0;
+		tail = 0;
+		frames.clear();
+		return reserve(size);
+	}
+
+	head = position + size;
+	return static_cast<VkDeviceSize>(position % capacity);
+}
+
+void StagingRing::readTimestamps(uint64_t completedFrame)
+{
+	uint32_t set = querySet(completedFrame);
+	if (!setHasTransfer[set / 2])
+	{
+		return;
+	}
+	setHasTransfer[set / 2] = false;
+
+	uint64_t ticks[2] = {};
+	if (vkd().vkGetQueryPoolResults(device, queryPool, set, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+	{
+		stats.transferMs += (ticks[1] - ticks[0]) * timestampPeriod / 1e6;
+	}
+}
+
+void StagingRing::recordCopies(VkCommandBuffer commandBuffer, bool release)
+{
+	// Earlier frames may still read the destinations, and earlier writes have to land first
+	VkMemoryBarrier before{};
+	before.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	before.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	before.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	std::vector<VkImageMemoryBarrier> toTransfer;
+	std::vector<VkImageMemoryBarrier> toFinal;
+	for (const ImageCopy& copy : imageCopies)
+	{
+		// Several regions of one subresource share its transition
+		const VkImageSubresourceLayers& sub = copy.region.imageSubresource;
+		auto same = [&](const VkImageMemoryBarrier& b) {
+			return b.image == copy.dst && b.subresourceRange.baseMipLevel == sub.mipLevel && b.subresourceRange.baseArrayLayer == sub.baseArrayLayer;
+		};
+		if (std::any_of(toTransfer.begin(), toTransfer.end(), same))
+		{
+			continue;
+		}
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = copy.dst;
+		barrier.subresourceRange = { copy.aspect, copy.region.imageSubresource.mipLevel, 1,
+			copy.region.imageSubresource.baseArrayLayer, copy.region.imageSubresource.layerCount };
+
+		barrier.oldLayout = copy.oldLayout;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toTransfer.push_back(barrier);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = copy.newLayout;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		if (release)
+		{
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			barrier.dstAccessMask = 0;
+			imageAcquires.push_back(barrier);
+			imageAcquires.back().srcAccessMask = 0;
+			imageAcquires.back().dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		}
+		toFinal.push_back(barrier);
+	}
+
+	vkd().vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0, nullptr,
+		static_cast<uint32_t>(toTransfer.size()), toTransfer.data());
+
+	// One copy command per destination, with every region queued for it
+	std::stable_sort(bufferCopies.begin(), bufferCopies.end(), [](const BufferCopy& a, const BufferCopy& b) { return a.dst < b.dst; });
+	std::vector<VkBufferCopy> regions;
+	std::vector<VkBufferCopy> sorted;
+	std::vector<VkBufferMemoryBarrier> releases;
+	for (size_t i = 0; i < bufferCopies.size();)
+	{
+		VkBuffer dst = bufferCopies[i].dst;
+		regions.clear();
+		for (; i < bufferCopies.size() && bufferCopies[i].dst == dst; i++)
+		{
+			regions.push_back(bufferCopies[i].region);
+		}
+
+		sorted = regions;
+		std::sort(sorted.begin(), sorted.end(), [](const VkBufferCopy& a, const VkBufferCopy& b) { return a.dstOffset < b.dstOffset; });
+		bool overlap = false;
+		for (size_t k = 1; k < sorted.size() && !overlap; k++)
+		{
+			overlap = sorted[k].dstOffset < sorted[k - 1].dstOffset + sorted[k - 1].size;
+		}
+
+		if (!overlap)
+		{
+			vkd().vkCmdCopyBuffer(commandBuffer, buffer, dst, static_cast<uint32_t>(sorted.size()), sorted.data());
+			stats.copyCommands++;
+		}
+		else
+		{
+			// Regions of one command are unordered, so rewrites of the same bytes go one by one, oldest first
+			VkMemoryBarrier between{};
+			between.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			between.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			between.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			for (size_t k = 0; k < regions.size(); k++)
+			{
+				if (k > 0)
+				{
+					vkd().vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &between, 0, nullptr, 0, nullptr);
+				}
+				vkd().vkCmdCopyBuffer(commandBuffer, buffer, dst, 1, &regions[k]);
+				stats.copyCommands++;
+			}
+		}
+		stats.regions += static_cast<uint32_t>(regions.size());
+
+		// Ownership moves per written range; touching ranges share one barrier
+		for (size_t k = 0; release && k < sorted.size();)
+		{
+			VkDeviceSize begin = sorted[k].dstOffset;
+			VkDeviceSize end = begin + sorted[k].size;
+			for (k++; k < sorted.size() && sorted[k].dstOffset <= end; k++)
+			{
+				end = std::max(end, sorted[k].dstOffset + sorted[k].size);
+			}
+
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			barrier.buffer = dst;
+			barrier.offset = begin;
+			barrier.size = end - begin;
+			releases.push_back(barrier);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			bufferAcquires.push_back(barrier);
+		}
+	}
+
+	std::stable_sort(imageCopies.begin(), imageCopies.end(), [](const ImageCopy& a, const ImageCopy& b) { return a.dst < b.dst; });
+	std::vector<VkBufferImageCopy> imageRegions;
+	for (size_t i = 0; i < imageCopies.size();)
+	{
+		VkImage dst = imageCopies[i].dst;
+		imageRegions.clear();
+		for (; i < imageCopies.size() && imageCopies[i].dst == dst; i++)
+		{
+			imageRegions.push_back(imageCopies[i].region);
+		}
+		vkd().vkCmdCopyBufferToImage(commandBuffer, buffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+		stats.copyCommands++;
+		stats.regions += static_cast<uint32_t>(imageRegions.size());
+	}
+
+	if (release)
+	{
+		// Visibility comes with the acquire on the graphics queue, after the semaphore
+		vkd().vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+			static_cast<uint32_t>(releases.size()), releases.data(), static_cast<uint32_t>(toFinal.size()), toFinal.data());
+	}
+	else
+	{
+		VkMemoryBarrier after{};
+		after.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		after.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		after.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkd().vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &after, 0, nullptr,
+			static_cast<uint32_t>(toFinal.size()), toFinal.data());
+	}
+
+	bufferCopies.clear();
+	imageCopies.clear();
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+struct StagingStats
+{
+	uint32_t uploads = 0;
+	uint64_t bytes = 0;
+	uint32_t copyCommands = 0;	// vkCmdCopyBuffer / vkCmdCopyBufferToImage calls recorded
+	uint32_t regions = 0;		// after merging contiguous uploads
+	uint32_t flushes = 0;		// flush() calls that had something to submit
+	uint32_t stalls = 0;		// ring was full of in-flight data and had to wait for the queue
+
+	// Transfer-queue mode; busy time comes from GPU timestamps when the transfer family supports them. Timestamps
+	// are only comparable within one queue, so overlap with rendering shows in frame times, not here.
+	uint32_t transferBatches = 0;
+	double transferMs = 0.0;	// transfer queue busy with uploads
+};
+
+// One persistently mapped host-visible buffer used as a ring for every CPU -> GPU upload. upload*() copies the
+// data in right away and queues the GPU copy; record() emits the queued copies batched per destination into the
+// frame's command buffer, and update() reclaims a frame's bytes once its fence has come round.
+//
+// Given a transfer queue from another family, submit() sends the frame's copies there instead, ending in
+// queue-family release barriers and a semaphore the frame's graphics submit waits on; record() then only
+// emits the matching acquire barriers. Buffer ranges written this way must not be in use by frames in flight,
+// and images must be uploaded from UNDEFINED (the graphics queue never released them).
+// Not thread safe: call from the render thread.
+class StagingRing
+{
+public:
+	void create(DeviceAllocator* allocator, VkQueue queue, uint32_t queueFamily, VkDeviceSize capacity = 32ull * 1024 * 1024,
+		VkQueue transferQueue = VK_NULL_HANDLE, uint32_t transferFamily = 0, uint32_t framesInFlight = 2);
+	void destroy();
+
+	// Uploads bigger than the ring are split; the GPU copy happens in the next record() or flush()
+	void uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	// region.bufferOffset/RowLength/ImageHeight are filled in; the image goes oldLayout -> TRANSFER_DST -> newLayout
+	void uploadImage(VkImage dst, const VkBufferImageCopy& region, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkImageAspectFlags aspect, const void* data, VkDeviceSize size);
+
+	// Transfer-queue mode: submits the queued copies and returns the semaphore this frame's graphics submit
+	// must wait on (at ALL_COMMANDS), or VK_NULL_HANDLE if there was nothing to upload. Call before record().
+	VkSemaphore submit();
+	// Records queued copies (or acquires what submit() sent); call outside a render pass, before anything reads the destinations
+	void record(VkCommandBuffer commandBuffer);
+	// Gives back the bytes of frames recorded up to frameNumber - framesInFlight
+	void update(uint64_t frameNumber, uint32_t framesInFlight);
+	// Submits queued copies on the ring's own command buffer and waits; for loading outside the frame loop
+	void flush();
+
+	bool hasPending() const { return !bufferCopies.empty() || !imageCopies.empty(); }
+	bool usesTransferQueue() const { return transferQueue != VK_NULL_HANDLE; }
+	VkDeviceSize getCapacity() const { return capacity; }
+	const StagingStats& getStats() const { return stats; }
+	void printStats() const;
+
+private:
+	struct BufferCopy
+	{
+		VkBuffer dst;
+		VkBufferCopy region;
+	};
+
+	struct ImageCopy
+	{
+		VkImage dst;
+		VkBufferImageCopy region;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		VkImageAspectFlags aspect;
+	};
+
+	struct FrameMark
+	{
+		uint64_t frameNumber;
+		uint64_t end;
+	};
+
+	DeviceAllocator* allocator = nullptr;
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkCommandBuffer flushCommandBuffer = VK_NULL_HANDLE;
+	VkFence flushFence = VK_NULL_HANDLE;
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	Allocation memory;
+	char* mapped = nullptr;
+	VkDeviceSize capacity = 0;
+
+	// Positions only grow; the physical offset is position % capacity. [tail, head) is in use.
+	uint64_t head = 0;
+	uint64_t tail = 0;
+	std::deque<FrameMark> frames;
+	uint64_t frameNumber = 0;
+
+	std::vector<BufferCopy> bufferCopies;
+	std::vector<ImageCopy> imageCopies;
+
+	// Transfer-queue mode; command buffers and semaphores per frame slot
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	uint32_t graphicsFamily = 0;
+	uint32_t transferFamily = 0;
+	uint32_t framesInFlight = 0;
+	VkCommandPool transferPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> transferCommandBuffers;
+	std::vector<VkSemaphore> transferSemaphores;
+	std::vector<VkBufferMemoryBarrier> bufferAcquires;
+	std::vector<VkImageMemoryBarrier> imageAcquires;
+
+	// 2 * framesInFlight sets of { transfer begin, transfer end }. Transfer queues can't reset queries, so
+	// graphics frame N resets the set frame N + framesInFlight will use.
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	double timestampPeriod = 0.0;	// ns per tick
+	std::vector<bool> setHasTransfer;
+
+	StagingStats stats;
+
+	// Offset into the buffer for size bytes, waiting on the queue if the ring is full
+	VkDeviceSize reserve(VkDeviceSize size);
+	// release: end in queue-family release barriers and remember the acquires
+	void recordCopies(VkCommandBuffer commandBuffer, bool release);
+	void createTransferResources();
+	void readTimestamps(uint64_t completedFrame);
+	uint32_t querySet(uint64_t frame) const { return static_cast<uint32_t>(frame % (2 * framesInFlight)) * 2; }
+};
@@ -0,0 +1,193 @@
+#include "StartupGraph.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+	double toMs(Profiler::Ticks ticks)
+	{
+		return static_cast<double>(ticks) / 1e6;
+	}
+}
+
+StartupGraph::Stage StartupGraph::add(const char* name, std::initializer_list<Stage> dependencies, Work work)
+{
+	return addNode(name, dependencies, std::move(work), false);
+}
+
+StartupGraph::Stage StartupGraph::addMainThread(const char* name, std::initializer_list<Stage> dependencies, Work work)
+{
+	return addNode(name, dependencies, std::move(work), true);
+}
+
+StartupGraph::Stage StartupGraph::addNode(const char* name, std::initializer_list<Stage> dependencies, Work work, bool mainThread)
+{
+	Stage stage = static_cast<Stage>(nodes.size());
+	for (Stage dependency : dependencies)
+	{
+		// Stages only depend on earlier ones, so the graph can't have cycles
+		if (dependency >= stage)
+		{
+			throw std::runtime_error(std::string("startup stage ") + name + " depends on a later stage!");
+		}
+		nodes[dependency].dependents.push_back(stage);
+	}
+
+	Node& node = nodes.emplace_back();
+	node.name = name;
+	node.work = std::move(work);
+	node.mainThread = mainThread;
+	node.dependencies = dependencies;
+	node.waitingOn.store(static_cast<uint32_t>(dependencies.size()), std::memory_order_relaxed);
+	return stage;
+}
+
+void StartupGraph::run(JobSystem& jobs_)
+{
+	jobs = &jobs_;
+	threads = jobs->threadCount();
+	runBegin = Profiler::now();
+	unfinished.store(static_cast<uint32_t>(nodes.size()), std::memory_order_relaxed);
+
+	for (Stage stage = 0; stage < nodes.size(); stage++)
+	{
+		if (nodes[stage].dependencies.empty())
+		{
+			schedule(stage);
+		}
+	}
+
+	while (unfinished.load(std::memory_order_acquire) > 0)
+	{
+		Stage next = UINT32_MAX;
+		{
+			std::lock_guard<std::mutex> lock(mainMutex);
+			if (!mainReady.empty())
+			{
+				next = mainReady.back();
+				mainReady.pop_back();
+			}
+		}
+
+		if (next != UINT32_MAX)
+		{
+			execute(next);
+		}
+		else if (!jobs->runPending())
+		{
+			std::this_thread::yield();
+		}
+	}
+	runEnd = Profiler::now();
+
+	if (!error.empty())
+	{
+		throw std::runtime_error(error);
+	}
+}
+
+void StartupGraph::schedule(Stage stage)
+{
+	if (nodes[stage].mainThread)
+	{
+		std::lock_guard<std::mutex> lock(mainMutex);
+		mainReady.push_back(stage);
+		return;
+	}
+	jobs->spawn([this, stage] { execute(stage); });
+}
+
+void StartupGraph::execute(Stage stage)
+{
+	Node& node = nodes[stage];
+	for (Stage dependency : node.dependencies)
+	{
+		node.failed = node.failed || nodes[dependency].failed;
+	}
+
+	if (!node.failed)
+	{
+		node.thread = jobs->workerIndex();
+		node.begin = Profiler::now();
+		try
+		{
+			ProfileScope scope(node.name);
+			node.work();
+		}
+		catch (const std::exception& e)
+		{
+			node.failed = true;
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if (error.empty())
+			{
+				error = e.what();
+			}
+		}
+		node.end = Profiler::now();
+	}
+
+	for (Stage dependent : node.dependents)
+	{
+		if (nodes[dependent].waitingOn.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			schedule(dependent);
+		}
+	}
+	// Last: run() may return, and the graph go away, as soon as this reaches zero
+	unfinished.fetch_sub(1, std::memory_order_release);
+}
+
+void StartupGraph::printReport() const
+{
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	double stageMs = 0.0;
+	Stage last = 0;
+	for (Stage stage = 0; stage < nodes.size(); stage++)
+	{
+		stageMs += toMs(nodes[stage].end - nodes[stage].begin);
+		if (nodes[stage].end > nodes[last].end)
+		{
+			last = stage;
+		}
+	}
+
+	printf("startup graph: %.2f ms on %u threads, %.2f ms of stage work\n", toMs(runEnd - runBegin), threads, stageMs);
+	printf("  %-20s %9s %9s %7s\n", "stage", "start ms", "time ms", "thread");
+	for (const Node& node : nodes)
+	{
+		printf("  %-20s %9.2f %9.2f %7u\n", node.name, toMs(node.begin - runBegin), toMs(node.end - node.begin), node.thread);
+	}
+
+	// Walk back from the stage that finished last through whichever dependency released it (the one that
+	// finished last); any time between stages on this path is scheduling latency
+	std::vector<Stage> path{ last };
+	while (!nodes[path.back()].dependencies.empty())
+	{
+		const std::vector<Stage>& dependencies = nodes[path.back()].dependencies;
+		Stage gate = dependencies[0];
+		for (Stage dependency : dependencies)
+		{
+			if (nodes[dependency].end > nodes[gate].end)
+			{
+				gate = dependency;
+			}
+		}
+		path.push_back(gate);
+	}
+
+	double pathMs = 0.0;
+	std::string names;
+	for (auto it = path.rbegin(); it != path.rend(); ++it)
+	{
+		pathMs += toMs(nodes[*it].end - nodes[*it].begin);
+		names += names.empty() ? "" : " -> ";
+		names += nodes[*it].name;
+	}
+	printf("critical path: %.2f ms in stages, done at %.2f ms: %s\n", pathMs, toMs(nodes[last].end - runBegin), names.c_str());
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Startup as a dependency graph: each stage runs on the JobSystem as soon as the stages it depends on have
+// finished, so independent work (shader compiles next to device creation, pipeline builds next to framebuffers)
+// overlaps. Stages that must stay on the calling thread (GLFW window queries, anything that start()s a JobSystem)
+// are added with addMainThread(). Every stage is timed; printReport() lists them and the critical path.
+class StartupGraph
+{
+public:
+	typedef uint32_t Stage;
+	typedef std::function<void()> Work;
+
+	// name must be a string literal (it also names the profiler scope)
+	Stage add(const char* name, std::initializer_list<Stage> dependencies, Work work);
+	Stage addMainThread(const char* name, std::initializer_list<Stage> dependencies, Work work);
+
+	// Runs every stage, the caller taking part as worker 0 of jobs. If a stage throws, the stages that depend
+	// on it are skipped and the first error is rethrown once the rest have finished.
+	void run(JobSystem& jobs);
+
+	void printReport() const;
+
+private:
+	struct Node
+	{
+		const char* name;
+		Work work;
+		bool mainThread;
+		std::vector<Stage> dependencies;
+		std::vector<Stage> dependents;
+		std::atomic<uint32_t> waitingOn{ 0 };
+		bool failed = false;	// written before dependents are released, read after
+		Profiler::Ticks begin = 0;
+		Profiler::Ticks end = 0;
+		uint32_t thread = 0;
+	};
+
+	std::deque<Node> nodes;	// Node holds an atomic, so it never moves
+	JobSystem* jobs = nullptr;
+	uint32_t threads = 0;
+	Profiler::Ticks runBegin = 0;
+	Profiler::Ticks runEnd = 0;
+	std::atomic<uint32_t> unfinished{ 0 };
+
+	std::mutex mainMutex;
+	std::vector<Stage> mainReady;	// addMainThread() stages waiting for the caller
+
+	std::mutex errorMutex;
+	std::string error;
+
+	Stage addNode(const char* name, std::initializer_list<Stage> dependencies, Work work, bool mainThread);
+	void schedule(Stage stage);
+	void execute(Stage stage);
+};
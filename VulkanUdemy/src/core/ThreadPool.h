@@ -0,0 +1,33 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads draining a FIFO of tasks
+class ThreadPool
+{
+public:
+	void start(uint32_t threadCount);
+	// Finishes queued tasks, then joins the workers
+	void stop();
+
+	void submit(std::function<void()> task);
+	// Blocks until the queue is empty and no task is running
+	void waitIdle();
+
+	uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable idle;
+	uint32_t running = 0;
+	bool stopping = false;
+
+	void workerLoop();
+};
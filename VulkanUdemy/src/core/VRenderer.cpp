@@ -1,4 +1,5 @@
 #include "VRenderer.h"
+#include "HostAllocator.h"
 
 
 VkResult VRenderer::CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMsnger)
@@ -90,7 +91,7 @@ void VRenderer::createInstance()
 
 	VkResult res;
 
-	res = vkCreateInstance(&iinfo, nullptr, &instance);
+	res = vkCreateInstance(&iinfo, hostCallbacks(), &instance);
 
 	if (res != VK_SUCCESS)
 	{	
@@ -124,7 +125,7 @@ void VRenderer::createLogicalDevice()
 	VkPhysicalDeviceFeatures features = {};
 	di.pEnabledFeatures = &features;
 
-	VkResult result = vkCreateDevice(mainDevice.gpu, &di, nullptr, &mainDevice.device);
+	VkResult result = vkCreateDevice(mainDevice.gpu, &di, hostCallbacks(), &mainDevice.device);
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create a logical Device!");
@@ -345,5 +346,5 @@ int VRenderer::init(GLFWwindow* window_)
 
 void VRenderer::cleanup()
 {
-	vkDestroyInstance(instance, nullptr);
+	vkDestroyInstance(instance, hostCallbacks());
 }
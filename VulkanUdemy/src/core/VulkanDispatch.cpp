@@ -0,0 +1,44 @@
+#include "VulkanDispatch.h"
+
+#include <stdexcept>
+#include <string>
+
+InstanceDispatch instanceDispatch;
+DeviceDispatch deviceDispatch;
+
+void InstanceDispatch::load(VkInstance instance)
+{
+#define VULKAN_LOAD_FUNCTION(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+	VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+
+	if (vkGetDeviceProcAddr == nullptr)
+	{
+		throw std::runtime_error("failed to load vkGetDeviceProcAddr!");
+	}
+}
+
+void DeviceDispatch::load(const InstanceDispatch& instance, VkDevice device)
+{
+#define VULKAN_LOAD_FUNCTION(name) \
+	name = reinterpret_cast<PFN_##name>(instance.vkGetDeviceProcAddr(device, #name)); \
+	if (name == nullptr) \
+	{ \
+		throw std::runtime_error(std::string("failed to load ") + #name + "!"); \
+	}
+	VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+
+#define VULKAN_LOAD_OPTIONAL_FUNCTION(name) name = reinterpret_cast<PFN_##name>(instance.vkGetDeviceProcAddr(device, #name));
+	VULKAN_SWAPCHAIN_FUNCTIONS(VULKAN_LOAD_OPTIONAL_FUNCTION)
+	VULKAN_PRESENT_WAIT_FUNCTIONS(VULKAN_LOAD_OPTIONAL_FUNCTION)
+#undef VULKAN_LOAD_OPTIONAL_FUNCTION
+}
+
+void DeviceDispatch::loadExports()
+{
+#define VULKAN_LOAD_FUNCTION(name) name = &::name;
+	VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+	VULKAN_SWAPCHAIN_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+// Extension entry points the loader doesn't export; null when the extension isn't enabled
+#define VULKAN_INSTANCE_FUNCTIONS(X) \
+	X(vkGetDeviceProcAddr) \
+	X(vkCreateDebugUtilsMessengerEXT) \
+	X(vkDestroyDebugUtilsMessengerEXT)
+
+// Everything called per frame or per draw. One-off creates and destroys stay on the loader's exports.
+#define VULKAN_DEVICE_FUNCTIONS(X) \
+	X(vkBeginCommandBuffer) \
+	X(vkEndCommandBuffer) \
+	X(vkResetCommandBuffer) \
+	X(vkResetCommandPool) \
+	X(vkCmdBeginRenderPass) \
+	X(vkCmdEndRenderPass) \
+	X(vkCmdExecuteCommands) \
+	X(vkCmdSetViewport) \
+	X(vkCmdSetScissor) \
+	X(vkCmdBindPipeline) \
+	X(vkCmdBindVertexBuffers) \
+	X(vkCmdBindIndexBuffer) \
+	X(vkCmdDraw) \
+	X(vkCmdDrawIndexed) \
+	X(vkCmdPipelineBarrier) \
+	X(vkCmdCopyBuffer) \
+	X(vkCmdCopyBufferToImage) \
+	X(vkCmdCopyImage) \
+	X(vkCmdResetQueryPool) \
+	X(vkCmdWriteTimestamp) \
+	X(vkGetQueryPoolResults) \
+	X(vkQueueSubmit) \
+	X(vkWaitForFences) \
+	X(vkResetFences) \
+	X(vkGetFenceStatus)
+
+// From VK_KHR_swapchain, which headless devices don't enable; null there
+#define VULKAN_SWAPCHAIN_FUNCTIONS(X) \
+	X(vkAcquireNextImageKHR) \
+	X(vkQueuePresentKHR)
+
+// From VK_KHR_present_wait, enabled only where supported. The loader doesn't export it, so loadExports() leaves
+// it null as well.
+#define VULKAN_PRESENT_WAIT_FUNCTIONS(X) \
+	X(vkWaitForPresentKHR)
+
+#define VULKAN_DECLARE_FUNCTION(name) PFN_##name name = nullptr;
+
+// Instance-level entry points, from vkGetInstanceProcAddr
+struct InstanceDispatch
+{
+	VULKAN_INSTANCE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+
+	void load(VkInstance instance);
+};
+
+// One device's entry points. A call through the loader's export goes through a trampoline that looks up the
+// device's dispatch table first; pointers from vkGetDeviceProcAddr jump straight into the driver (or the first
+// enabled layer). loadExports() fills the table with the loader's exports instead, for comparison.
+struct DeviceDispatch
+{
+	VULKAN_DEVICE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+	VULKAN_SWAPCHAIN_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+	VULKAN_PRESENT_WAIT_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+
+	void load(const InstanceDispatch& instance, VkDevice device);
+	void loadExports();
+};
+
+#undef VULKAN_DECLARE_FUNCTION
+
+// The tables for the application's instance and device; load each right after creating its object
+extern InstanceDispatch instanceDispatch;
+extern DeviceDispatch deviceDispatch;
+
+inline const InstanceDispatch& vki()
+{
+	return instanceDispatch;
+}
+
+inline const DeviceDispatch& vkd()
+{
+	return deviceDispatch;
+}